@@ -0,0 +1,79 @@
+// Benchmarks for ListLexer and the plain BackTrackParser in backtrack/.
+//
+//   g++ -O2 -std=c++14 bench/backtrack/main.cpp backtrack/parser.cpp -o bench_backtrack
+//   ./bench_backtrack --size 20000 --depth 3 --ambiguity 0.5
+
+#include "../../backtrack/parser.h"
+#include "../workload.h"
+
+
+static long long count_tokens(const std::vector<std::string> &stats)
+{
+	long long n = 0;
+	for (const auto &s : stats)
+	{
+		auto lexer = ListLexer(s);
+		while (lexer.nextToken().getType() != Lexer::LEOF_TYPE)
+			++n;
+	}
+	return n;
+}
+
+int main(int argc, char **argv)
+{
+	auto knobs = bench::parse_knobs(argc, argv);
+	auto stats = bench::Generator(knobs).list_statements();
+	auto tokens = count_tokens(stats);
+
+	auto lexed = bench::measure(knobs.reps, [&]() {
+		bench::keep(count_tokens(stats));
+	});
+	auto record = bench::Record("list_lexer");
+	bench::add_knobs(record, knobs)
+		.rate("tokens", tokens, lexed)
+		.add(lexed)
+		.print();
+
+	int ok = 0;
+	auto parsed = bench::measure(knobs.reps, [&]() {
+		ok = 0;
+		for (const auto &s : stats)
+		{
+			auto lexer = ListLexer(s);
+			auto parser = BackTrackParser(lexer);
+			if (parser.stat())
+				++ok;
+		}
+	});
+	record = bench::Record("backtrack_parser");
+	bench::add_knobs(record, knobs)
+		.add("parsed", ok)
+		.rate("statements", stats.size(), parsed)
+		.rate("tokens", tokens, parsed)
+		.add(parsed)
+		.print();
+
+	// about the same number of tokens at every depth, so falling tokens/sec
+	// is extra work per token.
+	for (int depth = 1; depth <= 256; depth *= 2)
+	{
+		std::vector<std::string> worst(knobs.size / depth + 1, bench::Generator::nested_assign(depth));
+		auto worst_tokens = count_tokens(worst);
+		auto sample = bench::measure(knobs.reps, [&]() {
+			for (const auto &s : worst)
+			{
+				auto lexer = ListLexer(s);
+				auto parser = BackTrackParser(lexer);
+				bench::keep(parser.stat());
+			}
+		});
+		bench::Record("speculation_worst_case")
+			.add("parser", "backtrack")
+			.add("nesting", depth)
+			.rate("statements", worst.size(), sample)
+			.rate("tokens", worst_tokens, sample)
+			.add(sample)
+			.print();
+	}
+	return 0;
+}
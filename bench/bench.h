@@ -0,0 +1,289 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <sstream>
+#include <streambuf>
+#include <vector>
+#include <utility>
+#include <type_traits>
+
+// Shared helpers for the benchmark programs under bench/.
+//
+// Every module in this repository defines its own Token/Lexer/Ast classes
+// in the global namespace, so each benchmark links against exactly one
+// module and is built on its own, e.g.
+//
+//   g++ -O2 -std=c++14 bench/memory_parser/main.cpp memory_parser/parser.cpp
+//
+// Results are written to stdout as one JSON object per line.
+//
+// This header replaces the global operator new/delete to count heap
+// traffic, so it must be included from exactly one translation unit,
+// the benchmark's main.cpp.
+
+namespace bench {
+
+inline std::atomic<long long> &allocation_count()
+{
+	static std::atomic<long long> count(0);
+	return count;
+}
+
+inline std::atomic<long long> &allocation_bytes()
+{
+	static std::atomic<long long> bytes(0);
+	return bytes;
+}
+
+} // namespace bench
+
+
+void *operator new(std::size_t size)
+{
+	bench::allocation_count().fetch_add(1, std::memory_order_relaxed);
+	bench::allocation_bytes().fetch_add(size, std::memory_order_relaxed);
+	if (void *p = std::malloc(size == 0 ? 1 : size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+// operator new above is malloc underneath, so free is the matching call;
+// GCC cannot see that through the replacement and warns.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+
+namespace bench {
+
+class Timer
+{
+public:
+	Timer() : start(std::chrono::steady_clock::now()) {}
+
+	double seconds() const
+	{
+		auto d = std::chrono::steady_clock::now() - start;
+		return std::chrono::duration<double>(d).count();
+	}
+
+private:
+	std::chrono::steady_clock::time_point start;
+};
+
+
+// Fastest time over the repetitions, and the heap traffic of one run.
+struct Sample
+{
+	double seconds = 0;
+	long long allocations = 0;
+	long long bytes = 0;
+};
+
+
+// Runs f `reps` times.
+template<class F>
+Sample measure(int reps, F f)
+{
+	Sample sample;
+	for (int i = 0; i < reps; ++i)
+	{
+		auto count = allocation_count().load();
+		auto bytes = allocation_bytes().load();
+		Timer t;
+		f();
+		auto s = t.seconds();
+		if (i == 0 || s < sample.seconds)
+			sample.seconds = s;
+		sample.allocations = allocation_count().load() - count;
+		sample.bytes = allocation_bytes().load() - bytes;
+	}
+	return sample;
+}
+
+// Like measure(), for bodies that consume their input: setup() builds a
+// fresh input outside the timed region and f(input) is timed.
+template<class S, class F>
+Sample measure_each(int reps, S setup, F f)
+{
+	Sample sample;
+	for (int i = 0; i < reps; ++i)
+	{
+		auto input = setup();
+		auto count = allocation_count().load();
+		auto bytes = allocation_bytes().load();
+		Timer t;
+		f(input);
+		auto s = t.seconds();
+		if (i == 0 || s < sample.seconds)
+			sample.seconds = s;
+		sample.allocations = allocation_count().load() - count;
+		sample.bytes = allocation_bytes().load() - bytes;
+	}
+	return sample;
+}
+
+// Runs f `reps` times and returns the fastest run in seconds.
+template<class F>
+double best_of(int reps, F f)
+{
+	return measure(reps, f).seconds;
+}
+
+
+// One line of JSON output. Values are added in order:
+//
+//   bench::Record("list_parser").add("variant", "memo").add(sample).print();
+class Record
+{
+public:
+	Record(const std::string &bench)
+	{
+		add("bench", bench);
+	}
+
+	Record &add(const std::string &key, const std::string &value)
+	{
+		std::string escaped;
+		for (auto c : value)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += c;
+		}
+		fields.push_back(std::make_pair(key, "\"" + escaped + "\""));
+		return *this;
+	}
+
+	Record &add(const std::string &key, const char *value)
+	{
+		return add(key, std::string(value));
+	}
+
+	Record &add(const std::string &key, double value)
+	{
+		std::ostringstream ss;
+		ss.precision(6);
+		ss << value;
+		fields.push_back(std::make_pair(key, ss.str()));
+		return *this;
+	}
+
+	Record &add(const std::string &key, bool value)
+	{
+		fields.push_back(std::make_pair(key, value ? "true" : "false"));
+		return *this;
+	}
+
+	template<class T>
+	typename std::enable_if<std::is_integral<T>::value, Record&>::type add(const std::string &key, T value)
+	{
+		fields.push_back(std::make_pair(key, std::to_string(value)));
+		return *this;
+	}
+
+	Record &add(const Sample &sample)
+	{
+		add("seconds", sample.seconds);
+		add("allocations", sample.allocations);
+		add("bytes_allocated", sample.bytes);
+		return *this;
+	}
+
+	// Adds "<unit>" and "<unit>_per_sec" for n units processed in the sample.
+	Record &rate(const std::string &unit, long long n, const Sample &sample)
+	{
+		add(unit, n);
+		add(unit + "_per_sec", sample.seconds > 0 ? n / sample.seconds : 0.0);
+		return *this;
+	}
+
+	void print(std::ostream &os = std::cout) const
+	{
+		os << "{";
+		for (size_t i = 0; i < fields.size(); ++i)
+		{
+			if (i != 0)
+				os << ", ";
+			os << "\"" << fields[i].first << "\": " << fields[i].second;
+		}
+		os << "}" << std::endl;
+	}
+
+private:
+	std::vector<std::pair<std::string, std::string>> fields;
+};
+
+
+// Swallows everything written to std::cout while in scope, for code under
+// test that traces to the console.
+class Quiet
+{
+public:
+	Quiet() : old(std::cout.rdbuf(&null)) {}
+	~Quiet() { std::cout.rdbuf(old); }
+	Quiet(const Quiet&) = delete;
+	Quiet &operator=(const Quiet&) = delete;
+
+private:
+	class NullBuffer : public std::streambuf
+	{
+	protected:
+		int overflow(int c) override { return c; }
+		std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+	};
+
+	NullBuffer null;
+	std::streambuf *old;
+};
+
+
+// the pointer itself is volatile, so a store to it cannot be dropped.
+inline const void *volatile &keep_sink()
+{
+	static const void *volatile sink = nullptr;
+	return sink;
+}
+
+// Keeps the optimizer from dropping a result that is otherwise unused.
+template<class T>
+void keep(const T &value)
+{
+	keep_sink() = &value;
+}
+
+} // namespace bench
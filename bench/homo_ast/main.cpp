@@ -0,0 +1,304 @@
+// Benchmarks for the homogeneous Ast in homo_ast/.
+//
+//   g++ -O2 -std=c++14 bench/homo_ast/main.cpp homo_ast/ast.cpp homo_ast/arena.cpp homo_ast/flat_ast.cpp homo_ast/ast_image.cpp homo_ast/reclaimer.cpp -pthread -o bench_homo_ast
+//   ./bench_homo_ast --size 2000 --depth 6
+
+#include "../../homo_ast/ast.h"
+#include "../../homo_ast/arena.h"
+#include "../../homo_ast/flat_ast.h"
+#include "../../homo_ast/ast_image.h"
+#include "../../homo_ast/reclaimer.h"
+#include <cstdio>
+#include "../workload.h"
+
+
+// (+ ...) inner nodes with two or three children down to `depth`, INT leaves.
+// make(type, text) creates one node with its token, an Ast or an ArenaNode.
+template<class Make>
+static auto random_tree(bench::Generator &gen, int depth, long long &nodes, Make make)
+{
+	++nodes;
+	if (depth == 0)
+		return make(AstToken::INT, std::to_string(gen.below(100)));
+	auto root = make(AstToken::PLUS, "+");
+	auto n = 2 + gen.below(2);
+	for (int i = 0; i < n; ++i)
+		root->add_child(random_tree(gen, depth - 1, nodes, make));
+	return root;
+}
+
+template<class Make>
+static auto random_trees(const bench::Knobs &knobs, long long &nodes, Make make)
+{
+	bench::Generator gen(knobs);
+	std::vector<decltype(make(AstToken::INT, std::string()))> trees;
+	nodes = 0;
+	for (int i = 0; i < knobs.size; ++i)
+		trees.push_back(random_tree(gen, knobs.depth, nodes, make));
+	return trees;
+}
+
+static Ast *heap_node(int type, const std::string &text)
+{
+	return new Ast(new AstToken(type, text));
+}
+
+static void print_build_teardown(const bench::Knobs &knobs, const char *variant, size_t node_bytes,
+	long long nodes, const bench::Sample &build, const bench::Sample &teardown)
+{
+	auto record = bench::Record("ast_build");
+	bench::add_knobs(record, knobs)
+		.add("variant", variant)
+		.add("node_bytes", node_bytes)
+		.add("bytes_per_node", nodes > 0 ? (double)build.bytes / nodes : 0.0)
+		.add("allocations_per_node", nodes > 0 ? (double)build.allocations / nodes : 0.0)
+		.rate("nodes", nodes, build)
+		.add(build)
+		.print();
+	record = bench::Record("ast_teardown");
+	bench::add_knobs(record, knobs)
+		.add("variant", variant)
+		.rate("nodes", nodes, teardown)
+		.add(teardown)
+		.print();
+}
+
+static void print_image(const bench::Knobs &knobs, const char *variant, long long nodes, const bench::Sample &sample)
+{
+	auto record = bench::Record("ast_image");
+	bench::add_knobs(record, knobs)
+		.add("variant", variant)
+		.rate("nodes", nodes, sample)
+		.add(sample)
+		.print();
+}
+
+// Saves all trees as one image under a nil root and compares loading it
+// back with building the trees again. homo_ast has no parser, so the
+// rebuild from the generator stands in for re-lexing and re-parsing.
+// The trees are owned, and freed, by the forest.
+static void bench_image(const bench::Knobs &knobs, const std::vector<Ast*> &trees, long long nodes)
+{
+	const std::string path = "bench_homo_ast.img";
+	Ast forest;
+	for (auto tree : trees)
+		forest.add_child(tree);
+
+	std::string image;
+	auto written = bench::measure(knobs.reps, [&]() {
+		image = AstImage::write(&forest);
+	});
+	print_image(knobs, "write", nodes, written);
+	if (!AstImage::save(&forest, path))
+		return;
+
+	auto expected = forest.to_string_tree();
+	bool round_trip = false;
+	{
+		MappedFile file(path);
+		AstImage view(file.data(), file.size());
+		auto copy = view.to_tree();
+		round_trip = view.to_string_tree() == expected && copy != nullptr && copy->to_string_tree() == expected;
+		delete copy;
+	}
+	auto record = bench::Record("ast_image");
+	bench::add_knobs(record, knobs)
+		.add("variant", "round_trip")
+		.add("image_bytes", image.size())
+		.add("ok", round_trip)
+		.print();
+
+	// map, validate and visit every node in place.
+	long long leaves = 0;
+	auto mapped = bench::measure(knobs.reps, [&]() {
+		MappedFile file(path);
+		AstImage view(file.data(), file.size());
+		leaves = 0;
+		for (uint32_t i = 0; i < view.size(); ++i)
+		{
+			if (view.node(i).get_node_type() == AstToken::INT)
+				++leaves;
+		}
+	});
+	bench::keep(leaves);
+	print_image(knobs, "mmap_walk", nodes, mapped);
+
+	auto loaded = bench::measure(knobs.reps, [&]() {
+		MappedFile file(path);
+		delete AstImage(file.data(), file.size()).to_tree();
+	});
+	print_image(knobs, "mmap_to_tree", nodes, loaded);
+
+	auto rebuilt = bench::measure(knobs.reps, [&]() {
+		long long n = 0;
+		for (auto tree : random_trees(knobs, n, heap_node))
+			delete tree;
+	});
+	print_image(knobs, "rebuild", nodes, rebuilt);
+
+	std::remove(path.c_str());
+}
+
+int main(int argc, char **argv)
+{
+	bench::Knobs defaults;
+	defaults.size = 2000;
+	defaults.depth = 6;
+	auto knobs = bench::parse_knobs(argc, argv, defaults);
+
+	long long nodes = 0;
+	auto trees = random_trees(knobs, nodes, heap_node);
+
+	size_t length = 0;
+	auto printed = bench::measure(knobs.reps, [&]() {
+		length = 0;
+		for (auto tree : trees)
+			length += tree->to_string_tree().size();
+	});
+	// node and token per node, the first children are inside the node;
+	// longer child lists and malloc headers come on top of this.
+	auto pointer_bytes = nodes * (sizeof(Ast) + sizeof(AstToken));
+	auto record = bench::Record("to_string_tree");
+	bench::add_knobs(record, knobs)
+		.add("variant", "pointer")
+		.add("tree_bytes", pointer_bytes)
+		.add("output_bytes", length)
+		.rate("nodes", nodes, printed)
+		.add(printed)
+		.print();
+
+	// every tree appended to one buffer, sized by the counting pass.
+	std::string buffer;
+	printed = bench::measure(knobs.reps, [&]() {
+		size_t size = 0;
+		for (auto tree : trees)
+			size += tree->string_tree_size();
+		buffer.clear();
+		buffer.reserve(size);
+		for (auto tree : trees)
+			tree->to_string_tree(buffer);
+	});
+	record = bench::Record("to_string_tree");
+	bench::add_knobs(record, knobs)
+		.add("variant", "pointer_presized_buffer")
+		.add("tree_bytes", pointer_bytes)
+		.add("output_bytes", buffer.size())
+		.rate("nodes", nodes, printed)
+		.add(printed)
+		.print();
+
+	// all trees in one forest, top-level nodes are the roots.
+	FlatAst flat;
+	for (auto tree : trees)
+		flat.add_tree(tree);
+	bench_image(knobs, trees, nodes);
+
+	printed = bench::measure(knobs.reps, [&]() {
+		length = 0;
+		for (auto root = flat.root(); root != FlatAst::NONE; root = flat.next_sibling(root))
+			length += flat.to_string_tree(root).size();
+	});
+	record = bench::Record("to_string_tree");
+	bench::add_knobs(record, knobs)
+		.add("variant", "flat")
+		.add("tree_bytes", flat.memory_bytes())
+		.add("output_bytes", length)
+		.rate("nodes", nodes, printed)
+		.add(printed)
+		.print();
+
+	long long leaves = 0;
+	auto walked = bench::measure(knobs.reps, [&]() {
+		leaves = 0;
+		for (auto root = flat.root(); root != FlatAst::NONE; root = flat.next_sibling(root))
+		{
+			auto cursor = flat.cursor(root);
+			do {
+				if (cursor.get_node_type() == AstToken::INT)
+					++leaves;
+			} while (cursor.goto_next());
+		}
+	});
+	record = bench::Record("preorder_walk");
+	bench::add_knobs(record, knobs)
+		.add("variant", "flat_cursor")
+		.add("leaves", leaves)
+		.rate("nodes", nodes, walked)
+		.add(walked)
+		.print();
+
+	// one new per node and token, freed by the recursive ~Ast.
+	std::vector<Ast*> built;
+	auto free_built = [&]() {
+		for (auto tree : built)
+			delete tree;
+		built.clear();
+		return 0;
+	};
+	auto build = bench::measure_each(knobs.reps, free_built, [&](int) {
+		built = random_trees(knobs, nodes, heap_node);
+	});
+	free_built();
+	auto teardown = bench::measure_each(knobs.reps, [&]() {
+		return random_trees(knobs, nodes, heap_node);
+	}, [](std::vector<Ast*> &trees) {
+		for (auto tree : trees)
+			delete tree;
+	});
+	print_build_teardown(knobs, "heap", sizeof(Ast), nodes, build, teardown);
+
+	// handing the trees to the background thread is all the caller pays.
+	{
+		AstReclaimer reclaimer;
+		auto handed_over = bench::measure_each(knobs.reps, [&]() {
+			reclaimer.drain();
+			return random_trees(knobs, nodes, heap_node);
+		}, [&](std::vector<Ast*> &trees) {
+			for (auto tree : trees)
+				reclaimer.reclaim(tree);
+		});
+		reclaimer.drain();
+		auto record = bench::Record("ast_teardown");
+		bench::add_knobs(record, knobs)
+			.add("variant", "reclaimer")
+			.rate("nodes", nodes, handed_over)
+			.add(handed_over)
+			.print();
+	}
+
+	// the same trees in one arena, freed by a single clear().
+	AstArena arena;
+	auto arena_node = [&](int type, const std::string &text) {
+		return arena.make_node(arena.make_token(type, text));
+	};
+	auto clear_arena = [&]() {
+		arena.clear();
+		return 0;
+	};
+	build = bench::measure_each(knobs.reps, clear_arena, [&](int) {
+		built = random_trees(knobs, nodes, arena_node);
+	});
+	teardown = bench::measure_each(knobs.reps, [&]() {
+		arena.clear();
+		return random_trees(knobs, nodes, arena_node);
+	}, [&](std::vector<Ast*> &) {
+		arena.clear();
+	});
+	print_build_teardown(knobs, "arena", sizeof(Ast), nodes, build, teardown);
+
+	// trivially destructible nodes: clear() only resets the blocks.
+	auto trivial_node = [&](int type, const std::string &text) {
+		return arena.make_arena_node(type, text);
+	};
+	build = bench::measure_each(knobs.reps, clear_arena, [&](int) {
+		random_trees(knobs, nodes, trivial_node);
+	});
+	teardown = bench::measure_each(knobs.reps, [&]() {
+		arena.clear();
+		return random_trees(knobs, nodes, trivial_node);
+	}, [&](std::vector<ArenaNode*> &) {
+		arena.clear();
+	});
+	print_build_teardown(knobs, "arena_trivial", sizeof(ArenaNode), nodes, build, teardown);
+	return 0;
+}
@@ -0,0 +1,93 @@
+// Benchmarks for the memoizing BackTrackParser in memory_parser/, both the
+// hand-written rules and the combinator grammar.
+//
+//   g++ -O2 -std=c++14 bench/memory_parser/main.cpp memory_parser/parser.cpp -o bench_memory_parser
+//   ./bench_memory_parser --size 20000 --depth 3 --ambiguity 0.5
+
+#include "../../memory_parser/parser.h"
+#include "../../memory_parser/combinator.h"
+#include "../workload.h"
+
+
+static long long count_tokens(const std::vector<std::string> &stats)
+{
+	long long n = 0;
+	for (const auto &s : stats)
+	{
+		auto lexer = ListLexer(s);
+		while (lexer.nextToken().getType() != Lexer::LEOF_TYPE)
+			++n;
+	}
+	return n;
+}
+
+template<class F>
+static void run(const std::string &variant, const bench::Knobs &knobs, const std::vector<std::string> &stats, F parse)
+{
+	auto tokens = count_tokens(stats);
+	int ok = 0;
+	auto sample = bench::measure(knobs.reps, [&]() {
+		ok = 0;
+		for (const auto &s : stats)
+		{
+			auto lexer = ListLexer(s);
+			auto parser = BackTrackParser(lexer);
+			parser.set_trace(false);
+			if (parse(parser))
+				++ok;
+		}
+	});
+	auto record = bench::Record("memo_parser");
+	bench::add_knobs(record, knobs)
+		.add("variant", variant)
+		.add("parsed", ok)
+		.rate("statements", stats.size(), sample)
+		.rate("tokens", tokens, sample)
+		.add(sample)
+		.print();
+}
+
+int main(int argc, char **argv)
+{
+	auto knobs = bench::parse_knobs(argc, argv);
+	auto stats = bench::Generator(knobs).list_statements();
+
+	run("hand_written", knobs, stats, [](BackTrackParser &p) {
+		return p.stat();
+	});
+	run("combinator", knobs, stats, [](BackTrackParser &p) {
+		return combinator::parse<combinator::list_grammar::Stat>(p);
+	});
+
+	// same family as bench/backtrack, with and without memoize_all.
+	for (int memoize_all = 0; memoize_all < 2; ++memoize_all)
+	{
+		for (int depth = 1; depth <= 256; depth *= 2)
+		{
+			std::vector<std::string> worst(knobs.size / depth + 1, bench::Generator::nested_assign(depth));
+			auto worst_tokens = count_tokens(worst);
+			MemoStats memo;
+			auto sample = bench::measure(knobs.reps, [&]() {
+				for (const auto &s : worst)
+				{
+					auto lexer = ListLexer(s);
+					auto parser = BackTrackParser(lexer);
+					parser.set_trace(false);
+					parser.set_memoize_all(memoize_all != 0);
+					bench::keep(parser.stat());
+					memo = parser.memo_stats();
+				}
+			});
+			bench::Record("speculation_worst_case")
+				.add("parser", memoize_all ? "memory_parser_memoize_all" : "memory_parser")
+				.add("nesting", depth)
+				.rate("statements", worst.size(), sample)
+				.rate("tokens", worst_tokens, sample)
+				.add(sample)
+				.add("memo_entries_per_statement", memo.entries)
+				.add("memo_peak_bytes_per_statement", memo.peak_bytes)
+				.print();
+		}
+	}
+	return 0;
+}
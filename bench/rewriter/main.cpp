@@ -0,0 +1,279 @@
+// Benchmarks for AstRewriter in walking/rewriter/.
+//
+//   g++ -O2 -std=c++14 bench/rewriter/main.cpp walking/rewriter/ast.cpp walking/rewriter/rule.cpp walking/rewriter/parser.cpp walking/rewriter/node_factory.cpp walking/rewriter/node_pool.cpp walking/rewriter/output_sink.cpp -o bench_rewriter
+//   ./bench_rewriter --size 20000 --depth 3 --veclen 3
+
+#include "../../walking/rewriter/ast.h"
+#include "../../walking/rewriter/rule.h"
+#include "../../walking/rewriter/parser.h"
+#include "../../walking/rewriter/node_factory.h"
+#include "../../walking/rewriter/visitor.h"
+#include "../workload.h"
+#include <unordered_set>
+
+
+static long long count_nodes(const Ast *node)
+{
+	switch (node->get_node_type())
+	{
+	case AstToken::ASSIGN:
+	{
+		auto n = static_cast<const AssignNode*>(node);
+		return 1 + count_nodes(n->left) + count_nodes(n->right);
+	}
+	case AstToken::PRINT:
+		return 1 + count_nodes(static_cast<const PrintNode*>(node)->element);
+	case AstToken::PLUS:
+	{
+		auto n = static_cast<const AddNode*>(node);
+		return 1 + count_nodes(n->left) + count_nodes(n->right);
+	}
+	case AstToken::MULT:
+	{
+		auto n = static_cast<const MultNode*>(node);
+		return 1 + count_nodes(n->left) + count_nodes(n->right);
+	}
+	case AstToken::DOT:
+	{
+		auto n = static_cast<const DotProductNode*>(node);
+		return 1 + count_nodes(n->left) + count_nodes(n->right);
+	}
+	case AstToken::LEFT_SHIFT:
+	{
+		auto n = static_cast<const LeftShiftNode*>(node);
+		return 1 + count_nodes(n->left) + count_nodes(n->right);
+	}
+	case AstToken::VEC:
+	{
+		long long n = 1;
+		for (auto ele : static_cast<const VecNode*>(node)->elements)
+			n += count_nodes(ele);
+		return n;
+	}
+	case AstToken::STAT_LIST:
+	{
+		long long n = 1;
+		for (auto ele : static_cast<const StatListNode*>(node)->elements)
+			n += count_nodes(ele);
+		return n;
+	}
+	default:
+		return 1;
+	}
+}
+
+// nodes reachable from version that are not part of original.
+static long long count_new_nodes(const Ast *original, const Ast *version)
+{
+	std::unordered_set<const Ast*> seen;
+	std::vector<const Ast*> stack = { original };
+	while (!stack.empty())
+	{
+		auto node = stack.back();
+		stack.pop_back();
+		if (!seen.insert(node).second)
+			continue;
+		for (size_t i = 0; i < node->child_count(); ++i)
+			stack.push_back(node->child(i));
+	}
+	long long n = 0;
+	stack.push_back(version);
+	while (!stack.empty())
+	{
+		auto node = stack.back();
+		stack.pop_back();
+		if (!seen.insert(node).second)
+			continue;
+		++n;
+		for (size_t i = 0; i < node->child_count(); ++i)
+			stack.push_back(node->child(i));
+	}
+	return n;
+}
+
+// what evaluating one node of each kind costs, in rough cycles.
+struct OpCosts
+{
+	int64_t load = 1;
+	int64_t add = 1;
+	int64_t mult = 3;
+	int64_t shift = 1;
+	int64_t dot = 4;
+	int64_t store = 1;
+	int64_t print = 20;
+};
+
+// the cost of evaluating a tree once, summed bottom-up.
+class CostModel : public Visitor<CostModel, int64_t, const OpCosts>
+{
+public:
+	int64_t leave(const IntNode *, const OpCosts &costs) { return costs.load; }
+	int64_t leave(const VarNode *, const OpCosts &costs) { return costs.load; }
+	int64_t leave(const PrintNode *, int64_t element, const OpCosts &costs) { return costs.print + element; }
+	int64_t leave(const AddNode *, int64_t l, int64_t r, const OpCosts &costs) { return costs.add + l + r; }
+	int64_t leave(const MultNode *, int64_t l, int64_t r, const OpCosts &costs) { return costs.mult + l + r; }
+	int64_t leave(const LeftShiftNode *, int64_t l, int64_t r, const OpCosts &costs) { return costs.shift + l + r; }
+	int64_t leave(const DotProductNode *, int64_t l, int64_t r, const OpCosts &costs) { return costs.dot + l + r; }
+	int64_t leave(const AssignNode *, int64_t, int64_t r, const OpCosts &costs) { return costs.store + r; }
+
+	template<class Node>
+	int64_t leave(const Node *, const std::vector<int64_t> &elements, const OpCosts &)
+	{
+		int64_t sum = 0;
+		for (auto ele : elements)
+			sum += ele;
+		return sum;
+	}
+};
+
+static Ast *parse(const std::string &source)
+{
+	auto lexer = Lexer(source);
+	auto parser = Parser(lexer);
+	return parser.program();
+}
+
+static void add_rules(AstRewriter &rewriter)
+{
+	rewriter.add_rule(new ScalarVecMultRule(Rule::TOPDOWN));
+	rewriter.add_rule(new MultZeroRule(Rule::BOTTOMUP));
+	rewriter.add_rule(new ZeroMultRule(Rule::BOTTOMUP));
+	rewriter.add_rule(new XPlusXRule(Rule::BOTTOMUP));
+	rewriter.add_rule(new MultByTwoRule(Rule::BOTTOMUP));
+	rewriter.add_rule(new CombineLeftShiftRule(Rule::BOTTOMUP));
+}
+
+int main(int argc, char **argv)
+{
+	auto knobs = bench::parse_knobs(argc, argv);
+	auto source = bench::Generator(knobs).vecmath_program();
+
+	const OpCosts costs;
+	CostModel cost_model;
+	Ast *program = parse(source);
+	auto nodes = count_nodes(program);
+	auto cost = cost_model.run(program, costs);
+	delete program;
+
+	AstRewriter rewriter;
+	add_rules(rewriter);
+	std::vector<Ast*> results;
+	auto rewritten = bench::measure_each(knobs.reps, [&]() {
+		return parse(source);
+	}, [&](Ast *program) {
+		rewriter.rewrite(program);
+		results.push_back(program);
+	});
+	auto rewritten_nodes = count_nodes(results.back());
+	auto rewritten_cost = cost_model.run(results.back(), costs);
+	for (auto result : results)
+		delete result;
+	auto record = bench::Record("ast_rewriter");
+	bench::add_knobs(record, knobs)
+		.add("variant", "cold")
+		.add("nodes_after", rewritten_nodes)
+		.add("cost_before", cost)
+		.add("cost_after", rewritten_cost)
+		.rate("statements", knobs.size, rewritten)
+		.rate("nodes", nodes, rewritten)
+		.add(rewritten)
+		.print();
+
+	// each result is freed before the next parse, so after the first
+	// round the rewrite finds every node it makes on a NodePool free list.
+	Ast *previous = nullptr;
+	auto steady = bench::measure_each(knobs.reps, [&]() {
+		delete previous;
+		previous = nullptr;
+		return parse(source);
+	}, [&](Ast *program) {
+		rewriter.rewrite(program);
+		previous = program;
+	});
+	delete previous;
+	record = bench::Record("ast_rewriter");
+	bench::add_knobs(record, knobs)
+		.add("variant", "steady_state")
+		.add("pool_chunks", NodePool::chunk_count())
+		.rate("statements", knobs.size, steady)
+		.rate("nodes", nodes, steady)
+		.add(steady)
+		.print();
+
+	// versions of one program, all kept alive: each only adds the nodes
+	// on the paths its rewrites changed, the rest is shared.
+	program = parse(source);
+	std::vector<Ast*> versions;
+	auto persistent = bench::measure(knobs.reps, [&]() {
+		versions.push_back(rewriter.rewrite_persistent(program));
+	});
+	auto in_place = parse(source);
+	rewriter.rewrite(in_place);
+	record = bench::Record("ast_rewriter");
+	bench::add_knobs(record, knobs)
+		.add("variant", "persistent")
+		.add("versions", versions.size())
+		.add("same_as_in_place", Ast::same(versions.back(), in_place))
+		.add("nodes_after", count_nodes(versions.back()))
+		.add("nodes_new", count_new_nodes(program, versions.back()))
+		.rate("statements", knobs.size, persistent)
+		.rate("nodes", nodes, persistent)
+		.add(persistent)
+		.print();
+	for (auto version : versions)
+		Ast::release(version);
+	delete in_place;
+	delete program;
+
+	// the same program with equal subtrees shared.
+	size_t unique_nodes = 0;
+	auto interned = bench::measure_each(knobs.reps, [&]() {
+		return parse(source);
+	}, [&](Ast *program) {
+		NodeFactory factory;
+		auto root = factory.intern_tree(program);
+		unique_nodes = factory.size();
+		Ast::release(root);
+	});
+	record = bench::Record("hash_consing");
+	bench::add_knobs(record, knobs)
+		.add("unique_nodes", unique_nodes)
+		.add("node_bytes", sizeof(MultNode) + sizeof(AstToken))
+		.rate("nodes", nodes, interned)
+		.add(interned)
+		.print();
+
+	// literals folded before the other bottom-up rules see them.
+	size_t removed = 0;
+	Ast *folded = nullptr;
+	auto folding = bench::measure_each(knobs.reps, [&]() {
+		delete folded;
+		folded = nullptr;
+		return parse(source);
+	}, [&](Ast *program) {
+		AstRewriter folder;
+		auto fold_rule = new ConstantFoldRule(Rule::BOTTOMUP);
+		folder.add_rule(new ScalarVecMultRule(Rule::TOPDOWN));
+		folder.add_rule(fold_rule);
+		folder.add_rule(new MultZeroRule(Rule::BOTTOMUP));
+		folder.add_rule(new ZeroMultRule(Rule::BOTTOMUP));
+		folder.add_rule(new XPlusXRule(Rule::BOTTOMUP));
+		folder.add_rule(new MultByTwoRule(Rule::BOTTOMUP));
+		folder.add_rule(new CombineLeftShiftRule(Rule::BOTTOMUP));
+		folder.rewrite(program);
+		removed = fold_rule->get_removed();
+		folded = program;
+	});
+	record = bench::Record("constant_folding");
+	bench::add_knobs(record, knobs)
+		.add("nodes_removed", removed)
+		.add("nodes_after", count_nodes(folded))
+		.add("cost_before", cost)
+		.add("cost_after", cost_model.run(folded, costs))
+		.rate("statements", knobs.size, folding)
+		.rate("nodes", nodes, folding)
+		.add(folding)
+		.print();
+	delete folded;
+	return 0;
+}
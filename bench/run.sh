@@ -0,0 +1,29 @@
+#!/bin/sh
+# Builds every benchmark program and runs it with the given knobs, writing
+# the JSON lines of all of them to stdout:
+#
+#   bench/run.sh --size 20000 --depth 3 > results.jsonl
+
+set -e
+cd "$(dirname "$0")/.."
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2 -std=c++14}
+OUT=${OUT:-/tmp/pl_bench}
+mkdir -p "$OUT"
+
+build() {
+	name=$1
+	shift
+	$CXX $CXXFLAGS "bench/$name/main.cpp" "$@" -o "$OUT/$name"
+}
+
+build backtrack backtrack/parser.cpp
+build memory_parser memory_parser/parser.cpp
+build symtab symtab/nested/parser.cpp symtab/nested/symbol.cpp
+build homo_ast homo_ast/ast.cpp homo_ast/arena.cpp homo_ast/flat_ast.cpp homo_ast/ast_image.cpp homo_ast/reclaimer.cpp -pthread
+build visitor walking/visitor/ast.cpp walking/visitor/parser.cpp walking/visitor/node_pool.cpp walking/visitor/output_sink.cpp walking/visitor/interpreter.cpp walking/visitor/bytecode.cpp walking/visitor/vm.cpp walking/visitor/vec_kernels.cpp walking/visitor/thread_pool.cpp -pthread
+build rewriter walking/rewriter/ast.cpp walking/rewriter/rule.cpp walking/rewriter/parser.cpp walking/rewriter/node_factory.cpp walking/rewriter/node_pool.cpp walking/rewriter/output_sink.cpp
+
+for name in backtrack memory_parser symtab homo_ast visitor rewriter; do
+	"$OUT/$name" "$@"
+done
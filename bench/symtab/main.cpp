@@ -0,0 +1,44 @@
+// Benchmarks for CymbolLexer and SymbolParser in symtab/nested/.
+//
+//   g++ -O2 -std=c++14 bench/symtab/main.cpp symtab/nested/parser.cpp symtab/nested/symbol.cpp -o bench_symtab
+//   ./bench_symtab --size 20000 --ident 6
+
+#include "../../symtab/nested/parser.h"
+#include "../workload.h"
+
+
+int main(int argc, char **argv)
+{
+	auto knobs = bench::parse_knobs(argc, argv);
+	auto source = bench::Generator(knobs).declarations();
+
+	long long tokens = 0;
+	auto lexed = bench::measure(knobs.reps, [&]() {
+		tokens = 0;
+		auto lexer = CymbolLexer(source);
+		while (lexer.nextToken().getType() != Lexer::LEOF_TYPE)
+			++tokens;
+	});
+	auto record = bench::Record("cymbol_lexer");
+	bench::add_knobs(record, knobs)
+		.add("bytes", source.size())
+		.rate("tokens", tokens, lexed)
+		.add(lexed)
+		.print();
+
+	auto parsed = bench::measure(knobs.reps, [&]() {
+		// SymbolParser traces every declaration it defines.
+		bench::Quiet quiet;
+		auto lexer = CymbolLexer(source);
+		auto parser = SymbolParser(lexer);
+		SymbolTable table;
+		parser.compile(&table);
+	});
+	record = bench::Record("symbol_parser");
+	bench::add_knobs(record, knobs)
+		.rate("statements", knobs.size, parsed)
+		.rate("tokens", tokens, parsed)
+		.add(parsed)
+		.print();
+	return 0;
+}
@@ -0,0 +1,498 @@
+// Benchmarks for the walking/visitor parser and AstVisitor.
+//
+//   g++ -O2 -std=c++14 bench/visitor/main.cpp walking/visitor/ast.cpp walking/visitor/parser.cpp walking/visitor/node_pool.cpp walking/visitor/output_sink.cpp walking/visitor/interpreter.cpp walking/visitor/bytecode.cpp walking/visitor/vm.cpp walking/visitor/vec_kernels.cpp walking/visitor/thread_pool.cpp -pthread -o bench_visitor
+//   ./bench_visitor --size 20000 --depth 3 --veclen 3
+
+#include "../../walking/visitor/ast.h"
+#include "../../walking/visitor/parser.h"
+#include "../../walking/visitor/interpreter.h"
+#include "../../walking/visitor/vm.h"
+#include "../../walking/visitor/vec_kernels.h"
+#include "../../walking/visitor/thread_pool.h"
+#include "../../walking/visitor/visitor.h"
+#include "../workload.h"
+#include <algorithm>
+#include <sstream>
+
+
+static long long count_nodes(const Ast *node)
+{
+	switch (node->get_node_type())
+	{
+	case AstToken::ASSIGN:
+	{
+		auto n = static_cast<const AssignNode*>(node);
+		return 1 + count_nodes(n->left) + count_nodes(n->right);
+	}
+	case AstToken::PRINT:
+		return 1 + count_nodes(static_cast<const PrintNode*>(node)->element);
+	case AstToken::PLUS:
+	{
+		auto n = static_cast<const AddNode*>(node);
+		return 1 + count_nodes(n->left) + count_nodes(n->right);
+	}
+	case AstToken::MULT:
+	{
+		auto n = static_cast<const MultNode*>(node);
+		return 1 + count_nodes(n->left) + count_nodes(n->right);
+	}
+	case AstToken::DOT:
+	{
+		auto n = static_cast<const DotProductNode*>(node);
+		return 1 + count_nodes(n->left) + count_nodes(n->right);
+	}
+	case AstToken::VEC:
+	{
+		long long n = 1;
+		for (auto ele : static_cast<const VecNode*>(node)->elements)
+			n += count_nodes(ele);
+		return n;
+	}
+	case AstToken::STAT_LIST:
+	{
+		long long n = 1;
+		for (auto ele : static_cast<const StatListNode*>(node)->elements)
+			n += count_nodes(ele);
+		return n;
+	}
+	default:
+		return 1;
+	}
+}
+
+// The same walk three ways: each returns the node count plus the sum of
+// the integer literals, so none of them can be optimized away.
+
+// the type switch with reinterpret_cast that AstVisitor used to have.
+static int64_t switch_sum(const Ast *node)
+{
+	switch (node->get_node_type())
+	{
+	case AstToken::ASSIGN:
+	{
+		auto n = reinterpret_cast<const AssignNode*>(node);
+		return 1 + switch_sum(n->left) + switch_sum(n->right);
+	}
+	case AstToken::PRINT:
+		return 1 + switch_sum(reinterpret_cast<const PrintNode*>(node)->element);
+	case AstToken::PLUS:
+	{
+		auto n = reinterpret_cast<const AddNode*>(node);
+		return 1 + switch_sum(n->left) + switch_sum(n->right);
+	}
+	case AstToken::MULT:
+	{
+		auto n = reinterpret_cast<const MultNode*>(node);
+		return 1 + switch_sum(n->left) + switch_sum(n->right);
+	}
+	case AstToken::DOT:
+	{
+		auto n = reinterpret_cast<const DotProductNode*>(node);
+		return 1 + switch_sum(n->left) + switch_sum(n->right);
+	}
+	case AstToken::INT:
+		return 1 + reinterpret_cast<const IntNode*>(node)->value;
+	case AstToken::VEC:
+	{
+		int64_t sum = 1;
+		for (auto ele : reinterpret_cast<const VecNode*>(node)->elements)
+			sum += switch_sum(ele);
+		return sum;
+	}
+	case AstToken::STAT_LIST:
+	{
+		int64_t sum = 1;
+		for (auto ele : reinterpret_cast<const StatListNode*>(node)->elements)
+			sum += switch_sum(ele);
+		return sum;
+	}
+	default:
+		return 1;
+	}
+}
+
+class StaticSum : public StaticVisitor<StaticSum, int64_t>
+{
+public:
+	int64_t visit(const AssignNode *node) const { return 1 + dispatch(node->left) + dispatch(node->right); }
+	int64_t visit(const PrintNode *node) const { return 1 + dispatch(node->element); }
+	int64_t visit(const AddNode *node) const { return 1 + dispatch(node->left) + dispatch(node->right); }
+	int64_t visit(const MultNode *node) const { return 1 + dispatch(node->left) + dispatch(node->right); }
+	int64_t visit(const DotProductNode *node) const { return 1 + dispatch(node->left) + dispatch(node->right); }
+	int64_t visit(const IntNode *node) const { return 1 + node->value; }
+	int64_t visit(const VarNode *) const { return 1; }
+
+	int64_t visit(const VecNode *node) const
+	{
+		int64_t sum = 1;
+		for (auto ele : node->elements)
+			sum += dispatch(ele);
+		return sum;
+	}
+
+	int64_t visit(const StatListNode *node) const
+	{
+		int64_t sum = 1;
+		for (auto ele : node->elements)
+			sum += dispatch(ele);
+		return sum;
+	}
+
+	int64_t visit_unknown(const Ast *) const { return 1; }
+};
+
+// the same sum, computed bottom-up from the results of the children.
+class FoldSum : public Visitor<FoldSum, int64_t>
+{
+public:
+	int64_t leave(const IntNode *node, NoContext&) { return 1 + node->value; }
+	int64_t leave(const VarNode *, NoContext&) { return 1; }
+	int64_t leave(const PrintNode *, int64_t element, NoContext&) { return 1 + element; }
+
+	template<class Node>
+	int64_t leave(const Node *, int64_t left, int64_t right, NoContext&) { return 1 + left + right; }
+
+	template<class Node>
+	int64_t leave(const Node *, const std::vector<int64_t> &elements, NoContext&)
+	{
+		int64_t sum = 1;
+		for (auto ele : elements)
+			sum += ele;
+		return sum;
+	}
+
+	int64_t leave_unknown(const Ast *, NoContext&) { return 1; }
+};
+
+class VirtualSum : public NodeVisitor
+{
+public:
+	void visit(const AssignNode *node) override { ++sum; node->left->accept(*this); node->right->accept(*this); }
+	void visit(const PrintNode *node) override { ++sum; node->element->accept(*this); }
+	void visit(const AddNode *node) override { ++sum; node->left->accept(*this); node->right->accept(*this); }
+	void visit(const MultNode *node) override { ++sum; node->left->accept(*this); node->right->accept(*this); }
+	void visit(const DotProductNode *node) override { ++sum; node->left->accept(*this); node->right->accept(*this); }
+	void visit(const IntNode *node) override { sum += 1 + node->value; }
+	void visit(const VarNode *) override { ++sum; }
+
+	void visit(const VecNode *node) override
+	{
+		++sum;
+		for (auto ele : node->elements)
+			ele->accept(*this);
+	}
+
+	void visit(const StatListNode *node) override
+	{
+		++sum;
+		for (auto ele : node->elements)
+			ele->accept(*this);
+	}
+
+	int64_t sum = 0;
+};
+
+// scale, add and dot over vectors of n elements, at every level this CPU
+// runs; "identical" compares each level's results with the scalar ones.
+static void bench_vec_kernels(const bench::Knobs &knobs, size_t n)
+{
+	const int rounds = 100;
+	std::vector<int64_t> a(n), b(n), out(n);
+	uint64_t x = (uint64_t)knobs.seed;
+	for (size_t i = 0; i < n; ++i)
+	{
+		// large values, so the products wrap.
+		x = x * 6364136223846793005u + 1442695040888963407u;
+		a[i] = (int64_t)x;
+		x = x * 6364136223846793005u + 1442695040888963407u;
+		b[i] = (int64_t)x;
+	}
+
+	auto best = VecKernels::best_level();
+	std::vector<int64_t> expected_scale, expected_add;
+	int64_t expected_dot = 0;
+	for (int level = VecKernels::SCALAR; level <= VecKernels::AVX2; ++level)
+	{
+		if (level > best || !VecKernels::use((VecKernels::Level)level))
+			continue;
+		const char *ops[] = { "scale", "add", "dot" };
+		for (int op = 0; op < 3; ++op)
+		{
+			int64_t dot = 0;
+			auto sample = bench::measure(knobs.reps, [&]() {
+				for (int r = 0; r < rounds; ++r)
+				{
+					if (op == 0)
+						VecKernels::scale(a[r], b.data(), out.data(), n);
+					else if (op == 1)
+						VecKernels::add(a.data(), b.data(), out.data(), n);
+					else
+						dot = VecKernels::dot(a.data(), b.data(), n);
+				}
+				bench::keep(out);
+			});
+			bool identical;
+			if (op == 0)
+			{
+				if (level == VecKernels::SCALAR)
+					expected_scale = out;
+				identical = out == expected_scale;
+			}
+			else if (op == 1)
+			{
+				if (level == VecKernels::SCALAR)
+					expected_add = out;
+				identical = out == expected_add;
+			}
+			else
+			{
+				if (level == VecKernels::SCALAR)
+					expected_dot = dot;
+				identical = dot == expected_dot;
+			}
+			auto record = bench::Record("vec_kernels");
+			bench::add_knobs(record, knobs)
+				.add("level", VecKernels::name((VecKernels::Level)level))
+				.add("op", ops[op])
+				.add("length", n)
+				.add("identical", identical)
+				.rate("elements", (long long)(n * rounds), sample)
+				.add(sample)
+				.print();
+		}
+	}
+	VecKernels::use(best);
+}
+
+// add and dot over long vectors, split over pools of 1, 2, 4... threads.
+// "speedup" is against one thread; the shortest length where it passes 1
+// is the place for VecKernels::set_parallel_threshold.
+static void bench_vec_parallel(const bench::Knobs &knobs)
+{
+	const size_t longest = 2 * 1024 * 1024;
+	std::vector<int64_t> a(longest), b(longest), out(longest);
+	for (size_t i = 0; i < longest; ++i)
+	{
+		a[i] = (int64_t)(i * 2654435761u);
+		b[i] = (int64_t)(i ^ 0x5bd1e995);
+	}
+	size_t most = std::max<size_t>(std::thread::hardware_concurrency(), 4);
+	auto old_threshold = VecKernels::parallel_threshold();
+	VecKernels::set_parallel_threshold(0);
+	for (size_t n = 2 * VecKernels::PARALLEL_CHUNK; n <= longest; n *= 2)
+	{
+		auto rounds = std::max<size_t>(1, 8 * longest / n);
+		const char *ops[] = { "add", "dot" };
+		for (int op = 0; op < 2; ++op)
+		{
+			double serial = 0;
+			int64_t serial_dot = 0;
+			std::vector<int64_t> serial_out;
+			for (size_t threads = 1; threads <= most; threads *= 2)
+			{
+				ThreadPool pool(threads);
+				VecKernels::set_pool(&pool);
+				int64_t dot = 0;
+				auto sample = bench::measure(knobs.reps, [&]() {
+					for (size_t r = 0; r < rounds; ++r)
+					{
+						if (op == 0)
+							VecKernels::add(a.data(), b.data(), out.data(), n);
+						else
+							dot = VecKernels::dot(a.data(), b.data(), n);
+					}
+					bench::keep(out);
+				});
+				if (threads == 1)
+				{
+					serial = sample.seconds;
+					serial_dot = dot;
+					serial_out.assign(out.begin(), out.begin() + n);
+				}
+				auto identical = dot == serial_dot && std::equal(serial_out.begin(), serial_out.end(), out.begin());
+				auto record = bench::Record("vec_parallel");
+				bench::add_knobs(record, knobs)
+					.add("op", ops[op])
+					.add("length", n)
+					.add("threads", threads)
+					.add("identical", identical)
+					.add("speedup", serial / sample.seconds)
+					.rate("elements", (long long)(n * rounds), sample)
+					.add(sample)
+					.print();
+			}
+		}
+	}
+	VecKernels::set_pool(nullptr);
+	VecKernels::set_parallel_threshold(old_threshold);
+}
+
+static void print_dispatch(const bench::Knobs &knobs, const char *variant, long long nodes,
+	int64_t sum, const bench::Sample &sample)
+{
+	auto record = bench::Record("node_dispatch");
+	bench::add_knobs(record, knobs)
+		.add("variant", variant)
+		.add("sum", sum)
+		.add("ns_per_node", sample.seconds * 1e9 / nodes)
+		.rate("nodes", nodes, sample)
+		.add(sample)
+		.print();
+}
+
+int main(int argc, char **argv)
+{
+	auto knobs = bench::parse_knobs(argc, argv);
+	auto source = bench::Generator(knobs).vecmath_program();
+
+	long long tokens = 0;
+	{
+		auto lexer = Lexer(source);
+		while (lexer.next_token().get_type() != Lexer::EOF_TYPE)
+			++tokens;
+	}
+
+	auto lexer = Lexer(source);
+	auto parser = Parser(lexer);
+	auto program = parser.program();
+	auto nodes = count_nodes(program);
+
+	// nodes and tokens come from NodePool: after the first round only
+	// lexer texts and the chunks the pool grows by are counted here.
+	auto parsed = bench::measure(knobs.reps, [&]() {
+		auto lexer = Lexer(source);
+		auto parser = Parser(lexer);
+		delete parser.program();
+	});
+	auto record = bench::Record("vecmath_parser");
+	bench::add_knobs(record, knobs)
+		.add("bytes", source.size())
+		.add("pool_chunks", NodePool::chunk_count())
+		.add("bytes_per_node", (double)parsed.bytes / nodes)
+		.add("allocations_per_node", (double)parsed.allocations / nodes)
+		.rate("statements", knobs.size, parsed)
+		.rate("tokens", tokens, parsed)
+		.rate("nodes", nodes, parsed)
+		.add(parsed)
+		.print();
+
+	std::ostringstream text;
+	{
+		AstVisitor to_text(text);
+		program->visit(&to_text);
+	}
+
+	AstVisitor visitor;
+	auto visited = bench::measure(knobs.reps, [&]() {
+		bench::Quiet quiet;
+		program->visit(&visitor);
+	});
+	record = bench::Record("ast_visitor");
+	bench::add_knobs(record, knobs)
+		.rate("output_bytes", text.str().size(), visited)
+		.rate("statements", knobs.size, visited)
+		.rate("nodes", nodes, visited)
+		.add(visited)
+		.print();
+
+	int64_t sum = 0;
+	auto switched = bench::measure(knobs.reps, [&]() {
+		sum = switch_sum(program);
+	});
+	print_dispatch(knobs, "switch", nodes, sum, switched);
+
+	auto statically = bench::measure(knobs.reps, [&]() {
+		sum = StaticSum().dispatch(program);
+	});
+	print_dispatch(knobs, "static", nodes, sum, statically);
+
+	auto virtually = bench::measure(knobs.reps, [&]() {
+		VirtualSum visitor;
+		program->accept(visitor);
+		sum = visitor.sum;
+	});
+	print_dispatch(knobs, "virtual", nodes, sum, virtually);
+
+	FoldSum fold;
+	auto folded = bench::measure(knobs.reps, [&]() {
+		sum = fold.run(program);
+	});
+	print_dispatch(knobs, "fold", nodes, sum, folded);
+
+	// variables are resolved to slots once, outside the timed runs.
+	Interpreter interpreter;
+	bool ok;
+	{
+		bench::Quiet quiet;
+		ok = interpreter.run(program);
+	}
+	auto evaluated = bench::measure(knobs.reps, [&]() {
+		bench::Quiet quiet;
+		ok = interpreter.execute(program) && ok;
+	});
+	record = bench::Record("interpreter");
+	bench::add_knobs(record, knobs)
+		.add("ok", ok)
+		.add("simd", VecKernels::name(VecKernels::level()))
+		.rate("statements", knobs.size, evaluated)
+		.rate("nodes", nodes, evaluated)
+		.add(evaluated)
+		.print();
+
+	// the same program compiled once and run on the VM; same_output
+	// compares what it prints with the interpreter's output.
+	Bytecode code;
+	BytecodeCompiler compiler;
+	auto compiled = bench::measure(knobs.reps, [&]() {
+		ok = compiler.compile(program, code);
+	});
+	std::ostringstream by_interpreter, by_vm;
+	Interpreter(by_interpreter).run(program);
+	VM(by_vm).run(code);
+	VM vm;
+	auto executed = bench::measure(knobs.reps, [&]() {
+		bench::Quiet quiet;
+		vm.run(code);
+	});
+	record = bench::Record("bytecode_vm");
+	bench::add_knobs(record, knobs)
+		.add("ok", ok)
+		.add("same_output", by_interpreter.str() == by_vm.str())
+		.add("instructions", code.code.size())
+		.add("registers", code.registers)
+		.add("compile_seconds", compiled.seconds)
+		.add("speedup", evaluated.seconds / executed.seconds)
+		.rate("statements", knobs.size, executed)
+		.rate("nodes", nodes, executed)
+		.add(executed)
+		.print();
+
+	// the same bytecode dispatched by a switch and by computed goto.
+	auto threaded_code = VM::prepare(code);
+	std::ostringstream by_threaded;
+	VM(by_threaded).run(threaded_code);
+	auto threaded = bench::measure(knobs.reps, [&]() {
+		bench::Quiet quiet;
+		vm.run(threaded_code);
+	});
+	auto dispatched = [&](const char *variant, const bench::Sample &sample) {
+		auto record = bench::Record("vm_dispatch");
+		bench::add_knobs(record, knobs)
+			.add("variant", variant)
+			.add("same_output", by_threaded.str() == by_vm.str())
+			.add("ns_per_instruction", sample.seconds * 1e9 / code.code.size())
+			.rate("instructions", code.code.size(), sample)
+			.rate("statements", knobs.size, sample)
+			.add(sample)
+			.print();
+	};
+	dispatched("switch", executed);
+	dispatched(VM::threaded() ? "computed_goto" : "switch_fallback", threaded);
+
+
+	bench_vec_kernels(knobs, knobs.size);
+	bench_vec_parallel(knobs);
+
+	delete program;
+	return 0;
+}
@@ -0,0 +1,270 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "bench.h"
+
+// Seeded synthetic inputs for the benchmarks. The same knobs always give
+// the same text, so runs are comparable across modules and commits.
+//
+//   --seed N        random seed
+//   --size N        statements / declarations / trees to generate
+//   --depth N       nesting depth of lists, expressions and trees
+//   --ident N       identifier length
+//   --ambiguity F   share of list statements of the form [..] = [..]
+//   --veclen N      elements per vector literal
+//   --reps N        timed repetitions, the fastest one is reported
+
+namespace bench {
+
+struct Knobs
+{
+	unsigned seed = 42;
+	int size = 10000;
+	int depth = 3;
+	int ident = 4;
+	double ambiguity = 0.5;
+	int veclen = 3;
+	int reps = 5;
+};
+
+inline Knobs parse_knobs(int argc, char **argv, Knobs knobs = Knobs())
+{
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const char *name = argv[i];
+		const char *value = argv[i + 1];
+		if (std::strcmp(name, "--seed") == 0)
+			knobs.seed = (unsigned)std::strtoul(value, nullptr, 10);
+		else if (std::strcmp(name, "--size") == 0)
+			knobs.size = std::atoi(value);
+		else if (std::strcmp(name, "--depth") == 0)
+			knobs.depth = std::atoi(value);
+		else if (std::strcmp(name, "--ident") == 0)
+			knobs.ident = std::atoi(value);
+		else if (std::strcmp(name, "--ambiguity") == 0)
+			knobs.ambiguity = std::atof(value);
+		else if (std::strcmp(name, "--veclen") == 0)
+			knobs.veclen = std::atoi(value);
+		else if (std::strcmp(name, "--reps") == 0)
+			knobs.reps = std::atoi(value);
+		else
+			std::cerr << "unknown option: " << name << std::endl;
+	}
+	return knobs;
+}
+
+inline Record &add_knobs(Record &record, const Knobs &knobs)
+{
+	return record.add("seed", knobs.seed)
+		.add("size", knobs.size)
+		.add("depth", knobs.depth)
+		.add("ident", knobs.ident)
+		.add("ambiguity", knobs.ambiguity)
+		.add("veclen", knobs.veclen);
+}
+
+
+class Generator
+{
+public:
+	Generator(const Knobs &knobs)
+		: knobs(knobs), rng(knobs.seed)
+	{}
+
+	// uniform in [0, n); plain modulo keeps the sequence identical across
+	// standard libraries.
+	int below(int n)
+	{
+		return n <= 1 ? 0 : int(rng() % unsigned(n));
+	}
+
+	bool chance(double p)
+	{
+		return (rng() % 1000000u) < unsigned(p * 1000000);
+	}
+
+	// lower case letters only, so every lexer accepts it as a name.
+	std::string ident()
+	{
+		std::string s;
+		do {
+			s.clear();
+			for (int i = 0; i < (knobs.ident > 0 ? knobs.ident : 1); ++i)
+				s += char('a' + below(26));
+		} while (is_keyword(s));
+		return s;
+	}
+
+	// an identifier not handed out by fresh_ident() before, so generated
+	// variables never change type. Clashes are lengthened until unique.
+	std::string fresh_ident()
+	{
+		auto s = ident();
+		while (is_keyword(s) || !used.insert(s).second)
+			s += char('a' + below(26));
+		return s;
+	}
+
+	// ---- list language (backtrack/, memory_parser/) ----
+	//   [a, b=c, [d, e]]    or, with probability `ambiguity`,   [..] = [..]
+
+	std::string list(int depth)
+	{
+		std::string s = "[";
+		auto n = 1 + below(3);
+		for (int i = 0; i < n; ++i)
+		{
+			if (i != 0)
+				s += ", ";
+			if (i == 0 && depth > 0)
+				s += list(depth - 1);
+			else if (chance(0.3))
+				s += ident() + "=" + ident();
+			else
+				s += ident();
+		}
+		return s + "]";
+	}
+
+	std::string list_statement()
+	{
+		if (chance(knobs.ambiguity))
+			return list(knobs.depth) + " = " + list(knobs.depth);
+		return list(knobs.depth);
+	}
+
+	std::vector<std::string> list_statements()
+	{
+		std::vector<std::string> stats;
+		for (int i = 0; i < knobs.size; ++i)
+			stats.push_back(list_statement());
+		return stats;
+	}
+
+	// Worst case for speculation: `stat` parses the whole left list under
+	// its first alternative, fails at '=' and parses it again as `assign`.
+	//   [[[a]]] = [[[b]]]
+	static std::string nested_assign(int depth)
+	{
+		return std::string(depth, '[') + "a" + std::string(depth, ']') + " = "
+			+ std::string(depth, '[') + "b" + std::string(depth, ']');
+	}
+
+	// ---- declarations (symtab/) ----
+	//   int abcd; float efgh = abcd;
+
+	std::string declarations()
+	{
+		std::string s;
+		std::vector<std::string> names;
+		for (int i = 0; i < knobs.size; ++i)
+		{
+			auto name = ident();
+			s += below(2) == 0 ? "int " : "float ";
+			s += name;
+			if (!names.empty() && chance(0.5))
+				s += " = " + names[below((int)names.size())];
+			s += ";\n";
+			names.push_back(name);
+		}
+		return s;
+	}
+
+	// ---- vector math (walking/) ----
+	//   x = 1 + 4; v = x * [2, 3, 4]; print v . [1, 0, 1]
+	//
+	// Expressions are generated by type, so every program is also valid
+	// for the evaluators: '.' takes two vectors, '*' an int and a vector.
+	// Compound operands are parenthesized so precedence cannot mix types.
+
+	std::string vecmath_program()
+	{
+		std::string s;
+		int_vars.clear();
+		vec_vars.clear();
+		used.clear();
+		for (int i = 0; i < knobs.size; ++i)
+		{
+			auto kind = below(3);
+			if (kind == 0)
+			{
+				auto name = fresh_ident();
+				s += name + " = " + int_expr(knobs.depth);
+				int_vars.push_back(name);
+			}
+			else if (kind == 1)
+			{
+				auto name = fresh_ident();
+				s += name + " = " + vec_expr(knobs.depth);
+				vec_vars.push_back(name);
+			}
+			else
+				s += "print " + (below(2) == 0 ? int_expr(knobs.depth) : vec_expr(knobs.depth));
+			s += ";\n";
+		}
+		return s;
+	}
+
+	std::string int_expr(int depth)
+	{
+		if (depth <= 0)
+		{
+			if (!int_vars.empty() && below(3) == 0)
+				return int_vars[below((int)int_vars.size())];
+			return std::to_string(below(10));
+		}
+		switch (below(3))
+		{
+		case 0:
+			return "(" + int_expr(depth - 1) + " + " + int_expr(depth - 1) + ")";
+		case 1:
+			return "(" + int_expr(depth - 1) + " * " + int_expr(depth - 1) + ")";
+		default:
+			return "(" + vec_expr(depth - 1) + " . " + vec_expr(depth - 1) + ")";
+		}
+	}
+
+	std::string vec_expr(int depth)
+	{
+		if (depth <= 0)
+		{
+			if (!vec_vars.empty() && below(3) == 0)
+				return vec_vars[below((int)vec_vars.size())];
+			std::string s = "[";
+			for (int i = 0; i < knobs.veclen; ++i)
+			{
+				if (i != 0)
+					s += ", ";
+				s += std::to_string(below(10));
+			}
+			return s + "]";
+		}
+		if (below(2) == 0)
+			return "(" + vec_expr(depth - 1) + " + " + vec_expr(depth - 1) + ")";
+		return "(" + int_expr(depth - 1) + " * " + vec_expr(depth - 1) + ")";
+	}
+
+	const Knobs &get_knobs() const
+	{
+		return knobs;
+	}
+
+private:
+	static bool is_keyword(const std::string &s)
+	{
+		return s == "print" || s == "int" || s == "float";
+	}
+
+	Knobs knobs;
+	std::mt19937 rng;
+	std::vector<std::string> int_vars;
+	std::vector<std::string> vec_vars;
+	std::unordered_set<std::string> used;
+};
+
+} // namespace bench
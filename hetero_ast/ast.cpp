@@ -1,7 +1,22 @@
 
 #include "ast.h"
+#include <iostream>
 #include <sstream>
 
+namespace
+{
+	// an empty place prints as nil.
+	std::string text_of(const ExprNode *node)
+	{
+		return node != nullptr ? node->to_string() : "nil";
+	}
+
+	std::string tree_of(const ExprNode *node)
+	{
+		return node != nullptr ? node->to_string_tree() : "nil";
+	}
+}
+
 const int AstToken::INVALID_TOKEN_TYPE;
 const int AstToken::PLUS;
 const int AstToken::INT;
@@ -64,14 +79,21 @@ const int ExprNode::tINT;
 const int ExprNode::tVEC;
 
 ExprNode::ExprNode(AstToken *token)
-	: Ast(token), eval_type(tINVALID) 
+	: Ast(token)
 { }
 
-const int ExprNode::get_eval_type() const
+int ExprNode::get_eval_type() const
 {
+	if (!type_known)
+		infer_types(const_cast<ExprNode*>(this));
 	return eval_type;
 }
 
+ExprNode *ExprNode::get_parent() const
+{
+	return parent;
+}
+
 std::string ExprNode::to_string() const
 {
 	if (eval_type != tINVALID)
@@ -80,26 +102,159 @@ std::string ExprNode::to_string() const
 		return Ast::to_string();
 }
 
+// Post-order with an explicit stack; subtrees that are already typed are
+// not entered again.
+int ExprNode::infer_types(ExprNode *root)
+{
+	int typed = 0;
+	std::vector<std::pair<ExprNode*, bool>> stack;
+	std::vector<ExprNode*> children;
+	if (root != nullptr)
+		stack.push_back(std::make_pair(root, false));
+	while (!stack.empty())
+	{
+		auto node = stack.back().first;
+		if (node->type_known)
+		{
+			stack.pop_back();
+			continue;
+		}
+		if (!stack.back().second)
+		{
+			stack.back().second = true;
+			children.clear();
+			node->get_children(children);
+			for (auto child : children)
+			{
+				if (child != nullptr && !child->type_known)
+					stack.push_back(std::make_pair(child, false));
+			}
+			continue;
+		}
+		node->eval_type = node->infer_type();
+		node->type_known = true;
+		++typed;
+		stack.pop_back();
+	}
+	return typed;
+}
+
+// a typed node has typed descendants, so the walk stops at the first
+// ancestor that is already untyped. The old type is dropped too, so it
+// is not printed before the node is retyped.
+void ExprNode::invalidate_type()
+{
+	for (auto node = this; node != nullptr && node->type_known; node = node->parent)
+	{
+		node->type_known = false;
+		node->eval_type = tINVALID;
+	}
+}
+
+int ExprNode::infer_type() const
+{
+	return eval_type;
+}
+
+void ExprNode::get_children(std::vector<ExprNode*> &) const
+{}
+
+void ExprNode::release_child(ExprNode *)
+{}
+
+bool ExprNode::adopt(ExprNode *parent, ExprNode *child)
+{
+	if (child == nullptr)
+		return true;
+	for (auto node = parent; node != nullptr; node = node->parent)
+	{
+		if (node == child)
+		{
+			std::cout << "cannot make " << child->to_string() << " a child of itself or of a node under it" << std::endl;
+			return false;
+		}
+	}
+	if (child->parent != nullptr)
+		child->parent->release_child(child);
+	child->parent = parent;
+	return true;
+}
+
+void ExprNode::orphan(ExprNode *child)
+{
+	if (child != nullptr)
+		child->parent = nullptr;
+}
+
 AddNode::AddNode(ExprNode *left, AstToken *add, ExprNode *right)
 	:ExprNode(add), left(left), right(right)
-{ }
+{
+	adopt(this, left);
+	adopt(this, right);
+}
 
 std::string AddNode::to_string_tree() const
 {
 	std::stringstream ss;
-	ss << "(" << to_string() << " " << left->to_string() << " " << right->to_string() << ")";
+	ss << "(" << to_string() << " " << text_of(left) << " " << text_of(right) << ")";
 	return ss.str();
 }
 
-const int AddNode::get_eval_type() const
+ExprNode *AddNode::set_left(ExprNode *node)
 {
-	return tINT;
+	if (node == left || !adopt(this, node))
+		return nullptr;
+	auto old = left;
+	left = node;
+	orphan(old);
+	invalidate_type();
+	return old;
+}
+
+ExprNode *AddNode::set_right(ExprNode *node)
+{
+	if (node == right || !adopt(this, node))
+		return nullptr;
+	auto old = right;
+	right = node;
+	orphan(old);
+	invalidate_type();
+	return old;
+}
+
+int AddNode::infer_type() const
+{
+	if (left == nullptr || right == nullptr)
+		return tINVALID;
+	auto l = left->get_eval_type();
+	auto r = right->get_eval_type();
+	if (l == tINVALID || r == tINVALID)
+		return tINVALID;
+	if (l == tINT && r == tINT)
+		return tINT;
+	return tVEC;
+}
+
+void AddNode::get_children(std::vector<ExprNode*> &out) const
+{
+	out.push_back(left);
+	out.push_back(right);
+}
+
+void AddNode::release_child(ExprNode *child)
+{
+	if (left == child)
+		left = nullptr;
+	if (right == child)
+		right = nullptr;
+	invalidate_type();
 }
 
 IntNode::IntNode(AstToken *token)
 	: ExprNode(token)
 {
 	eval_type = tINT;
+	type_known = true;
 }
 
 std::string IntNode::to_string_tree() const
@@ -109,6 +264,11 @@ std::string IntNode::to_string_tree() const
 	return ss.str();
 }
 
+int IntNode::infer_type() const
+{
+	return tINT;
+}
+
 VecNode::VecNode(AstToken *token, std::vector<ExprNode*> elements)
 	: ExprNode(token)
 {
@@ -128,8 +288,44 @@ VecNode::VecNode(AstToken *token, std::initializer_list<ExprNode*> elements)
 void VecNode::add_child(ExprNode *node)
 {
 	elements.push_back(node);
+	adopt(this, node);
+}
+
+ExprNode *VecNode::set_element(size_t i, ExprNode *node)
+{
+	if (node == elements[i] || !adopt(this, node))
+		return nullptr;
+	auto old = elements[i];
+	elements[i] = node;
+	orphan(old);
+	invalidate_type();
+	return old;
+}
+
+int VecNode::infer_type() const
+{
+	for (auto element : elements)
+	{
+		if (element == nullptr || element->get_eval_type() != tINT)
+			return tINVALID;
+	}
+	return tVEC;
+}
+
+void VecNode::get_children(std::vector<ExprNode*> &out) const
+{
+	out.insert(out.end(), elements.begin(), elements.end());
 }
 
+void VecNode::release_child(ExprNode *child)
+{
+	for (auto &element : elements)
+	{
+		if (element == child)
+			element = nullptr;
+	}
+	invalidate_type();
+}
 std::string VecNode::to_string_tree() const
 {
 	if (elements.size() == 0)
@@ -145,7 +341,7 @@ std::string VecNode::to_string_tree() const
 	{
 		if (iter != elements.cbegin())
 			ss << " ";
-		ss << (*iter)->to_string_tree();
+		ss << tree_of(*iter);
 	}
 	if (!is_nil())
 		ss << ")";
@@ -1,6 +1,7 @@
 #ifndef _AST_H
 #define _AST_H
 
+#include "small_vector.h"
 #include <string>
 #include <vector>
 
@@ -42,30 +43,71 @@ protected:
 };
 
 
+// Expression types are inferred bottom-up and cached in eval_type:
+// get_eval_type() runs infer_types() over the part of the tree not yet
+// typed, then answers from the cache. Replacing a child through
+// set_left/set_right/set_element drops the cached types from there up
+// to the root, so the next query retypes only that path.
+//
+// A node has one parent. Giving a node that is already a child to a new
+// parent takes it from the old one, whose place for it is left empty
+// until something is set there; an empty place types as tINVALID and
+// prints as nil. A node cannot be given to itself or to a node under it,
+// as the tree would become a cycle.
 class ExprNode : public Ast
 {
 public:
 	ExprNode() = default;
 	ExprNode(AstToken *token);
 
-	virtual const int get_eval_type() const;
+	int get_eval_type() const;
+	ExprNode *get_parent() const;
 	std::string to_string() const override;
 
+	// types every untyped node under root, children first; returns the
+	// number of nodes typed.
+	static int infer_types(ExprNode *root);
+	// forgets the cached type of this node and its ancestors.
+	void invalidate_type();
+
 	static const int tINVALID = 0;
 	static const int tINT = 1;
 	static const int tVEC = 2;
 
 protected:
-	int eval_type;
+	// the type of this node from the cached types of its children.
+	virtual int infer_type() const;
+	virtual void get_children(std::vector<ExprNode*> &out) const;
+	// empties the place of a child that another node is taking.
+	virtual void release_child(ExprNode *child);
+	// false, with a message printed, if child is parent or one of its
+	// ancestors.
+	static bool adopt(ExprNode *parent, ExprNode *child);
+	// a child that was replaced has no parent.
+	static void orphan(ExprNode *child);
+
+	mutable int eval_type = tINVALID;
+	mutable bool type_known = false;
+	ExprNode *parent = nullptr;
 };
 
+// int + int is int; vec + vec, and an int added to a vec, are vec.
 class AddNode :public ExprNode
 {
 public:
 	AddNode(ExprNode *left, AstToken *add, ExprNode *right);
 
-	const int get_eval_type() const override;
 	std::string to_string_tree() const override;
+	// replace a child and return the old one, which the caller now owns;
+	// nullptr, with nothing changed, if node already was that child or
+	// would make a cycle.
+	ExprNode *set_left(ExprNode *node);
+	ExprNode *set_right(ExprNode *node);
+
+protected:
+	int infer_type() const override;
+	void get_children(std::vector<ExprNode*> &out) const override;
+	void release_child(ExprNode *child) override;
 
 private:
 	ExprNode *left;
@@ -77,20 +119,31 @@ class IntNode :public ExprNode
 public:
 	IntNode(AstToken *token);
 	std::string to_string_tree() const override;
+
+protected:
+	int infer_type() const override;
 };
 
+// a vector of ints; any other element makes the vector tINVALID.
 class VecNode : public ExprNode
 {
 public:
 	VecNode(AstToken *token, std::vector<ExprNode*> elements);
 	VecNode(AstToken *token, std::initializer_list<ExprNode*> elements);
 	std::string to_string_tree() const override;
+	// as AddNode::set_left.
+	ExprNode *set_element(size_t i, ExprNode *node);
+
+protected:
+	int infer_type() const override;
+	void get_children(std::vector<ExprNode*> &out) const override;
+	void release_child(ExprNode *child) override;
 
 private:
 	void add_child(ExprNode *node);
 
 private:
-	std::vector<ExprNode*> elements;
+	SmallVector<ExprNode*, 4> elements;
 
 };
 
@@ -19,6 +19,27 @@ int main()
 	auto vec = new VecNode(nullptr, elements);
 	std::cout << vec->to_string_tree() << std::endl;
 
+	// 1 + [1, 2, 3]: the int is added to every element, so the sum is a vec.
+	auto sum = new AddNode(new IntNode(new AstToken(AstToken::INT, "1")), new AstToken(AstToken::PLUS, "+"), vec);
+	ExprNode::infer_types(sum);
+	std::cout << sum->to_string_tree() << std::endl;
+
+	// 1 + 4 after replacing the vector; only the sum is typed again.
+	auto four = new IntNode(new AstToken(AstToken::INT, "4"));
+	auto old = sum->set_right(four);
+	std::cout << "untyped: " << sum->to_string_tree() << std::endl;
+	std::cout << ExprNode::infer_types(sum) << " retyped: " << sum->to_string_tree() << std::endl;
+	std::cout << "vec still " << (old->get_eval_type() == ExprNode::tVEC ? "tVEC" : "not tVEC")
+		<< (old->get_parent() == nullptr ? ", detached" : ", still attached") << std::endl;
+
+	// moving the 4 into the vector empties its place in the sum.
+	static_cast<VecNode*>(old)->set_element(0, four);
+	ExprNode::infer_types(sum);
+	std::cout << sum->to_string_tree() << " " << old->to_string_tree() << std::endl;
+
+	// a sum cannot hold itself.
+	std::cout << (sum->set_left(sum) == nullptr ? "refused" : "accepted") << std::endl;
+
 
 	return 0;
 
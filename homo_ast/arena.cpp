@@ -0,0 +1,158 @@
+#include "arena.h"
+#include <cstring>
+
+static_assert(std::is_trivially_destructible<ArenaNode>::value, "clear() must not have to finalize an ArenaNode");
+
+bool ArenaNode::is_nil() const
+{
+	return text == nullptr;
+}
+
+void ArenaNode::add_child(ArenaNode *child)
+{
+	if (last_child != nullptr)
+		last_child->next_sibling = child;
+	else
+		first_child = child;
+	last_child = child;
+}
+
+std::string ArenaNode::to_string() const
+{
+	return is_nil() ? "nil" : std::string(text, text_length);
+}
+
+std::string ArenaNode::to_string_tree() const
+{
+	std::string out;
+	to_string_tree(out);
+	return out;
+}
+
+void ArenaNode::to_string_tree(std::string &out) const
+{
+	if (first_child == nullptr)
+	{
+		out += to_string();
+		return;
+	}
+	if (!is_nil())
+	{
+		out += "(";
+		out.append(text, text_length);
+		out += " ";
+	}
+	for (auto child = first_child; child != nullptr; child = child->next_sibling)
+	{
+		if (child != first_child)
+			out += " ";
+		child->to_string_tree(out);
+	}
+	if (!is_nil())
+		out += ")";
+}
+
+
+AstArena::AstArena(size_t block_size)
+	: block_size(block_size)
+{}
+
+AstArena::~AstArena()
+{
+	clear();
+	for (auto block : blocks)
+		delete[] block;
+}
+
+AstToken *AstArena::make_token(int type, const std::string &text)
+{
+	return create<AstToken>(type, text);
+}
+
+AstToken *AstArena::make_token(int type)
+{
+	return create<AstToken>(type);
+}
+
+Ast *AstArena::make_node(AstToken *token)
+{
+	return create<Ast>(token);
+}
+
+Ast *AstArena::make_node(int type)
+{
+	return create<Ast>(make_token(type));
+}
+
+Ast *AstArena::make_nil()
+{
+	return create<Ast>();
+}
+
+ArenaNode *AstArena::make_arena_node(int type, const std::string &text)
+{
+	auto node = make_arena_nil();
+	auto copy = static_cast<char*>(allocate(text.size(), 1));
+	std::memcpy(copy, text.data(), text.size());
+	node->type = type;
+	node->text = copy;
+	node->text_length = (uint32_t)text.size();
+	return node;
+}
+
+ArenaNode *AstArena::make_arena_nil()
+{
+	return create<ArenaNode>(ArenaNode{ AstToken::INVALID_TOKEN_TYPE, nullptr, 0, nullptr, nullptr, nullptr });
+}
+
+void *AstArena::allocate(size_t size, size_t align)
+{
+	auto p = cur == nullptr ? 0 : (reinterpret_cast<std::uintptr_t>(cur) + align - 1) & ~(std::uintptr_t)(align - 1);
+	if (cur == nullptr || p + size > reinterpret_cast<std::uintptr_t>(end))
+	{
+		new_block(size + align);
+		p = (reinterpret_cast<std::uintptr_t>(cur) + align - 1) & ~(std::uintptr_t)(align - 1);
+	}
+	cur = reinterpret_cast<char*>(p + size);
+	used += size;
+	return reinterpret_cast<void*>(p);
+}
+
+void AstArena::clear()
+{
+	for (auto iter = finalizers.rbegin(); iter != finalizers.rend(); ++iter)
+		iter->destroy(iter->object);
+	finalizers.clear();
+
+	for (size_t i = 1; i < blocks.size(); ++i)
+		delete[] blocks[i];
+	if (!blocks.empty())
+		blocks.resize(1);
+	cur = blocks.empty() ? nullptr : blocks[0];
+	end = blocks.empty() ? nullptr : blocks[0] + block_size;
+	used = 0;
+}
+
+size_t AstArena::bytes_used() const
+{
+	return used;
+}
+
+void AstArena::detach(Ast *node)
+{
+	node->children.clear();
+	node->token = nullptr;
+}
+
+void AstArena::new_block(size_t size)
+{
+	// the first block is always block_size so clear() can keep it;
+	// oversized requests get a block of their own.
+	if (blocks.empty() && size > block_size)
+		new_block(block_size);
+	auto n = size > block_size ? size : block_size;
+	auto block = new char[n];
+	blocks.push_back(block);
+	cur = block;
+	end = block + n;
+}
@@ -0,0 +1,110 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include "ast.h"
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A node whose text and child links are arena memory too, which makes it
+// trivially destructible. Children are a singly linked list, so adding
+// one allocates nothing. Prints like Ast:
+//
+//   auto root = arena.make_arena_node(AstToken::PLUS, "+");
+//   root->add_child(arena.make_arena_node(AstToken::INT, "1"));
+struct ArenaNode
+{
+	int type;
+	// nullptr for nil nodes.
+	const char *text;
+	uint32_t text_length;
+	ArenaNode *first_child;
+	ArenaNode *last_child;
+	ArenaNode *next_sibling;
+
+	bool is_nil() const;
+	void add_child(ArenaNode *child);
+	std::string to_string() const;
+	std::string to_string_tree() const;
+	void to_string_tree(std::string &out) const;
+};
+
+// Owns every node and token of a tree. Objects are placed by bumping a
+// pointer through large blocks and are all destroyed together by clear()
+// or the arena's destructor, never by delete:
+//
+//   AstArena arena;
+//   auto root = arena.make_node(arena.make_token(AstToken::PLUS, "+"));
+//   root->add_child(arena.make_node(arena.make_token(AstToken::INT, "1")));
+//
+// Arena nodes must only have arena children. Objects made with create<T>()
+// are finalized in reverse order of creation, unless T is trivially
+// destructible: then they are not remembered at all. Ast and AstToken own
+// a vector and a string, so the trees above are finalized node by node;
+// ArenaNode is the node to use when clear() should run nothing.
+class AstArena
+{
+public:
+	AstArena(size_t block_size = 64 * 1024);
+	~AstArena();
+	AstArena(const AstArena&) = delete;
+	AstArena &operator=(const AstArena&) = delete;
+
+	AstToken *make_token(int type, const std::string &text);
+	AstToken *make_token(int type);
+	Ast *make_node(AstToken *token);
+	Ast *make_node(int type);
+	Ast *make_nil();
+	ArenaNode *make_arena_node(int type, const std::string &text);
+	ArenaNode *make_arena_nil();
+
+	template<class T, class... Args>
+	T *create(Args&&... args)
+	{
+		auto object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		if (!std::is_trivially_destructible<T>::value)
+			finalizers.push_back(Finalizer{ &finalize<T>, object });
+		return object;
+	}
+
+	void *allocate(size_t size, size_t align);
+
+	// destroys everything, keeps the first block for reuse.
+	void clear();
+	size_t bytes_used() const;
+
+private:
+	struct Finalizer
+	{
+		void (*destroy)(void*);
+		void *object;
+	};
+
+	// ~Ast deletes its children and token; in the arena they belong to
+	// the arena, so they are dropped from the node before it is destroyed.
+	static void detach(Ast *node);
+	static void detach(const void*) {}
+
+	template<class T>
+	static void finalize(void *object)
+	{
+		auto p = static_cast<T*>(object);
+		detach(p);
+		p->~T();
+	}
+
+	void new_block(size_t size);
+
+	size_t block_size;
+	std::vector<char*> blocks;
+	char *cur = nullptr;
+	char *end = nullptr;
+	size_t used = 0;
+	std::vector<Finalizer> finalizers;
+};
+
+#endif // !_ARENA_H
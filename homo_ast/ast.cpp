@@ -1,6 +1,5 @@
 
 #include "ast.h"
-#include <sstream>
 
 const int AstToken::INVALID_TOKEN_TYPE;
 const int AstToken::PLUS;
@@ -19,6 +18,11 @@ std::string AstToken::to_string() const
 	return text;
 }
 
+const std::string &AstToken::get_text() const
+{
+	return text;
+}
+
 int AstToken::get_type() const
 {
 	return type;
@@ -33,10 +37,21 @@ Ast::Ast(int type)
 	token = new AstToken(type);
 }
 
+// Descendants are freed from an explicit stack rather than by recursion:
+// each node's children are taken before it is deleted, so its own
+// destructor finds none and deep trees cannot overflow the call stack.
 Ast::~Ast()
 {
-	for (auto child : children)
-		delete child;
+	std::vector<Ast*> stack(children.begin(), children.end());
+	children.clear();
+	while (!stack.empty())
+	{
+		auto node = stack.back();
+		stack.pop_back();
+		stack.insert(stack.end(), node->children.begin(), node->children.end());
+		node->children.clear();
+		delete node;
+	}
 	delete token;
 }
 
@@ -60,25 +75,32 @@ std::string Ast::to_string() const
 	return token != nullptr ? token->to_string() : "nil";
 }
 
+size_t Ast::text_size() const
+{
+	return token != nullptr ? token->get_text().size() : 3;
+}
+
 std::string Ast::to_string_tree() const
+{
+	std::string out;
+	write_tree(out);
+	return out;
+}
+
+void Ast::to_string_tree(std::string &out) const
+{
+	write_tree(out);
+}
+
+size_t Ast::string_tree_size() const
 {
 	if (children.size() == 0)
-		return to_string();
-	std::stringstream ss;
-	if (!is_nil())
-	{
-		ss << "(";
-		ss << to_string();
-		ss << " ";
-	}
-	for (auto iter = children.cbegin(); iter != children.cend(); ++iter)
-	{
-		if (iter != children.cbegin())
-			ss << " ";
-		ss << (*iter)->to_string_tree();
-	}
-	if (!is_nil())
-		ss << ")";
-	return ss.str();
+		return text_size();
+	// "(" text " " ... ")" around the children, one space between them.
+	auto size = is_nil() ? 0 : text_size() + 3;
+	size += children.size() - 1;
+	for (auto child : children)
+		size += child->string_tree_size();
+	return size;
 }
 
@@ -0,0 +1,302 @@
+#include "ast_image.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <cstdlib>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char IMAGE_MAGIC[4] = { 'A', 'S', 'T', 'I' };
+
+const uint32_t NodeRecord::NIL;
+const uint32_t AstImage::VERSION;
+
+std::string AstImage::write(const Ast *tree)
+{
+	std::vector<NodeRecord> records;
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> string_offsets;
+
+	// breadth first: the children of the node at `next` are appended right
+	// behind the records already queued, so their indices are known.
+	std::vector<const Ast*> queue = { tree };
+	for (size_t next = 0; next < queue.size(); ++next)
+	{
+		auto node = queue[next];
+		NodeRecord record = {};
+		if (node->is_nil())
+			record.flags = NodeRecord::NIL;
+		else
+		{
+			auto text = node->token->to_string();
+			auto res = string_offsets.find(text);
+			if (res == string_offsets.end())
+			{
+				res = string_offsets.insert(std::make_pair(text, (uint32_t)strings.size())).first;
+				strings += text;
+			}
+			record.type = node->token->get_type();
+			record.text_offset = res->second;
+			record.text_length = (uint32_t)text.size();
+		}
+		record.first_child = (uint32_t)queue.size();
+		record.child_count = (uint32_t)node->children.size();
+		for (auto child : node->children)
+			queue.push_back(child);
+		records.push_back(record);
+	}
+
+	ImageHeader header = {};
+	std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+	header.version = VERSION;
+	header.node_count = (uint32_t)records.size();
+	header.nodes_offset = sizeof(ImageHeader);
+	header.strings_offset = header.nodes_offset + header.node_count * sizeof(NodeRecord);
+	header.strings_size = (uint32_t)strings.size();
+	for (auto &record : records)
+		record.text_offset += header.strings_offset;
+
+	std::string image;
+	image.reserve(header.strings_offset + strings.size());
+	image.append(reinterpret_cast<const char*>(&header), sizeof(header));
+	image.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(NodeRecord));
+	image += strings;
+	return image;
+}
+
+bool AstImage::save(const Ast *tree, const std::string &path)
+{
+	std::ofstream file(path, std::ios::binary);
+	auto image = write(tree);
+	if (!file.write(image.data(), image.size()))
+	{
+		std::cout << "cannot write ast image: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Every record is checked once here, so the accessors can trust the
+// offsets without bounds checks.
+AstImage::AstImage(const void *data, size_t size)
+{
+	auto bytes = static_cast<const char*>(data);
+	if (bytes == nullptr || size < sizeof(ImageHeader))
+		return;
+	auto h = reinterpret_cast<const ImageHeader*>(bytes);
+	if (std::memcmp(h->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 || h->version != VERSION)
+		return;
+	if (h->node_count == 0 || h->nodes_offset % alignof(NodeRecord) != 0
+		|| h->nodes_offset > size || (size - h->nodes_offset) / sizeof(NodeRecord) < h->node_count
+		|| h->strings_offset > size || size - h->strings_offset < h->strings_size)
+		return;
+
+	auto records = reinterpret_cast<const NodeRecord*>(bytes + h->nodes_offset);
+	auto strings_end = (uint64_t)h->strings_offset + h->strings_size;
+	// breadth first, as write() lays it out: each record's children are
+	// the next ones no earlier record has claimed. So every record but
+	// the root is the child of exactly one record before it, and no walk
+	// can loop or visit a record twice.
+	uint64_t next_child = 1;
+	for (uint32_t i = 0; i < h->node_count; ++i)
+	{
+		const auto &r = records[i];
+		if (i >= next_child)
+			return;
+		if (r.child_count != 0)
+		{
+			if (r.first_child != next_child || next_child + r.child_count > h->node_count)
+				return;
+			next_child += r.child_count;
+		}
+		if ((r.flags & NodeRecord::NIL) == 0
+			&& (r.text_offset < h->strings_offset || (uint64_t)r.text_offset + r.text_length > strings_end))
+			return;
+	}
+	this->data = bytes;
+	header = h;
+	nodes = records;
+}
+
+bool AstImage::is_valid() const
+{
+	return header != nullptr;
+}
+
+uint32_t AstImage::size() const
+{
+	return header != nullptr ? header->node_count : 0;
+}
+
+AstImage::Node AstImage::root() const
+{
+	return node(0);
+}
+
+AstImage::Node AstImage::node(uint32_t index) const
+{
+	return Node(this, nodes + index);
+}
+
+std::string AstImage::to_string_tree() const
+{
+	std::string out;
+	if (is_valid())
+		root().append_tree(out);
+	return out;
+}
+
+Ast *AstImage::to_tree() const
+{
+	return is_valid() ? root().to_tree() : nullptr;
+}
+
+
+std::string AstImage::Node::to_string() const
+{
+	return is_nil() ? "nil" : std::string(text(), text_length());
+}
+
+// Both walks keep their own stack, so an image of a deep tree does not
+// overflow the call stack.
+void AstImage::Node::append_tree(std::string &out) const
+{
+	struct Frame
+	{
+		Node node;
+		uint32_t next;
+	};
+	std::vector<Frame> stack = { Frame{ *this, 0 } };
+	while (!stack.empty())
+	{
+		auto node = stack.back().node;
+		auto next = stack.back().next;
+		if (node.child_count() == 0)
+		{
+			if (node.is_nil())
+				out += "nil";
+			else
+				out.append(node.text(), node.text_length());
+			stack.pop_back();
+			continue;
+		}
+		if (next == 0 && !node.is_nil())
+		{
+			out += "(";
+			out.append(node.text(), node.text_length());
+			out += " ";
+		}
+		if (next == node.child_count())
+		{
+			if (!node.is_nil())
+				out += ")";
+			stack.pop_back();
+			continue;
+		}
+		if (next != 0)
+			out += " ";
+		stack.back().next = next + 1;
+		stack.push_back(Frame{ node.child(next), 0 });
+	}
+}
+
+// children are pushed last to first, so each parent gets them in order.
+Ast *AstImage::Node::to_tree() const
+{
+	Ast *root = nullptr;
+	std::vector<std::pair<Node, Ast*>> stack = { std::make_pair(*this, (Ast*)nullptr) };
+	while (!stack.empty())
+	{
+		auto node = stack.back().first;
+		auto parent = stack.back().second;
+		stack.pop_back();
+		auto copy = node.is_nil() ? new Ast()
+			: new Ast(new AstToken(node.get_node_type(), std::string(node.text(), node.text_length())));
+		if (parent != nullptr)
+			parent->add_child(copy);
+		else
+			root = copy;
+		for (uint32_t i = node.child_count(); i > 0; --i)
+			stack.push_back(std::make_pair(node.child(i - 1), copy));
+	}
+	return root;
+}
+
+
+#ifdef _WIN32
+
+// no mmap here; the file is read into a heap buffer instead.
+MappedFile::MappedFile(const std::string &path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		std::cout << "cannot open ast image: " << path << std::endl;
+		return;
+	}
+	length = (size_t)file.tellg();
+	addr = std::malloc(length == 0 ? 1 : length);
+	file.seekg(0);
+	file.read(static_cast<char*>(addr), length);
+}
+
+MappedFile::~MappedFile()
+{
+	std::free(addr);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path)
+{
+	auto fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		std::cout << "cannot open ast image: " << path << std::endl;
+		return;
+	}
+	struct stat st;
+	if (::fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		auto p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED)
+		{
+			addr = p;
+			length = (size_t)st.st_size;
+		}
+	}
+	::close(fd);
+	if (addr == nullptr)
+		std::cout << "cannot map ast image: " << path << std::endl;
+}
+
+MappedFile::~MappedFile()
+{
+	if (addr != nullptr)
+		::munmap(addr, length);
+}
+
+#endif
+
+bool MappedFile::is_open() const
+{
+	return addr != nullptr;
+}
+
+const void *MappedFile::data() const
+{
+	return addr;
+}
+
+size_t MappedFile::size() const
+{
+	return length;
+}
@@ -0,0 +1,114 @@
+#ifndef _AST_IMAGE_H
+#define _AST_IMAGE_H
+
+#include "ast.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Binary image of an Ast, laid out to be used in place: a file written by
+// AstImage::save() can be mapped with MappedFile and walked through AstImage
+// without parsing or allocating anything.
+//
+//   header    ImageHeader
+//   nodes     node_count NodeRecords in breadth-first order, root first,
+//             so the children of a node are one contiguous run of records
+//   strings   token texts, not terminated
+//
+// All offsets are in bytes from the start of the image. Integers are
+// stored in the byte order of the machine that wrote the image.
+struct ImageHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t node_count;
+	uint32_t nodes_offset;
+	uint32_t strings_offset;
+	uint32_t strings_size;
+};
+
+struct NodeRecord
+{
+	int32_t type;
+	uint32_t flags;
+	uint32_t text_offset;
+	uint32_t text_length;
+	uint32_t first_child;
+	uint32_t child_count;
+
+	static const uint32_t NIL = 1;
+};
+
+
+// A read-only view of an image in memory; the bytes must outlive it.
+class AstImage
+{
+public:
+	class Node;
+
+	AstImage() = default;
+	AstImage(const void *data, size_t size);
+
+	static std::string write(const Ast *tree);
+	static bool save(const Ast *tree, const std::string &path);
+
+	// false for a truncated or foreign image; nothing else may be used then.
+	bool is_valid() const;
+	uint32_t size() const;
+	Node root() const;
+	Node node(uint32_t index) const;
+
+	// same text as Ast::to_string_tree of the saved tree.
+	std::string to_string_tree() const;
+	// builds a heap copy of the tree, to be deleted by the caller.
+	Ast *to_tree() const;
+
+	static const uint32_t VERSION = 1;
+
+private:
+	const char *data = nullptr;
+	const ImageHeader *header = nullptr;
+	const NodeRecord *nodes = nullptr;
+};
+
+class AstImage::Node
+{
+public:
+	Node(const AstImage *image, const NodeRecord *record) : image(image), record(record) {}
+
+	int get_node_type() const { return record->type; }
+	bool is_nil() const { return (record->flags & NodeRecord::NIL) != 0; }
+	const char *text() const { return image->data + record->text_offset; }
+	size_t text_length() const { return record->text_length; }
+	std::string to_string() const;
+	uint32_t child_count() const { return record->child_count; }
+	Node child(uint32_t i) const { return image->node(record->first_child + i); }
+
+	void append_tree(std::string &out) const;
+	Ast *to_tree() const;
+
+private:
+	const AstImage *image;
+	const NodeRecord *record;
+};
+
+
+// A whole file mapped read-only into memory, unmapped on destruction.
+class MappedFile
+{
+public:
+	MappedFile(const std::string &path);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile &operator=(const MappedFile&) = delete;
+
+	bool is_open() const;
+	const void *data() const;
+	size_t size() const;
+
+private:
+	void *addr = nullptr;
+	size_t length = 0;
+};
+
+#endif // !_AST_IMAGE_H
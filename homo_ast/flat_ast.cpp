@@ -0,0 +1,210 @@
+#include "flat_ast.h"
+
+const uint32_t FlatAst::NONE;
+
+uint32_t FlatAst::begin_node(int type, const std::string &text)
+{
+	return add(type, intern(text));
+}
+
+uint32_t FlatAst::begin_node(int type)
+{
+	return add(type, intern(""));
+}
+
+uint32_t FlatAst::begin_nil()
+{
+	return add(AstToken::INVALID_TOKEN_TYPE, NONE);
+}
+
+void FlatAst::end_node()
+{
+	if (open.size() > 1)
+		open.pop_back();
+}
+
+uint32_t FlatAst::leaf(int type, const std::string &text)
+{
+	auto node = begin_node(type, text);
+	end_node();
+	return node;
+}
+
+uint32_t FlatAst::add(int type, uint32_t token)
+{
+	auto node = (uint32_t)types.size();
+	types.push_back(type);
+	tokens.push_back(token);
+	first_children.push_back(NONE);
+	next_siblings.push_back(NONE);
+
+	auto &parent = open.back();
+	if (parent.last_child == NONE)
+	{
+		if (parent.node != NONE)
+			first_children[parent.node] = node;
+	}
+	else
+		next_siblings[parent.last_child] = node;
+	parent.last_child = node;
+
+	open.push_back(Open{ node, NONE });
+	return node;
+}
+
+uint32_t FlatAst::intern(const std::string &text)
+{
+	auto res = text_index.find(text);
+	if (res != text_index.end())
+		return res->second;
+	auto index = (uint32_t)texts.size();
+	texts.push_back(text);
+	text_index.insert(std::make_pair(text, index));
+	return index;
+}
+
+FlatAst FlatAst::from_tree(const Ast *tree)
+{
+	FlatAst flat;
+	flat.add_tree(tree);
+	return flat;
+}
+
+uint32_t FlatAst::add_tree(const Ast *tree)
+{
+	auto node = tree->is_nil() ? begin_nil() : begin_node(tree->token->get_type(), tree->token->to_string());
+	for (auto child : tree->children)
+		add_tree(child);
+	end_node();
+	return node;
+}
+
+uint32_t FlatAst::size() const
+{
+	return (uint32_t)types.size();
+}
+
+uint32_t FlatAst::root() const
+{
+	return types.empty() ? NONE : 0;
+}
+
+int FlatAst::get_node_type(uint32_t node) const
+{
+	return types[node];
+}
+
+bool FlatAst::is_nil(uint32_t node) const
+{
+	return tokens[node] == NONE;
+}
+
+uint32_t FlatAst::first_child(uint32_t node) const
+{
+	return first_children[node];
+}
+
+uint32_t FlatAst::next_sibling(uint32_t node) const
+{
+	return next_siblings[node];
+}
+
+FlatAst::Children FlatAst::children(uint32_t node) const
+{
+	return Children(this, first_children[node]);
+}
+
+FlatAst::Cursor FlatAst::cursor(uint32_t node) const
+{
+	return Cursor(this, node);
+}
+
+std::string FlatAst::to_string(uint32_t node) const
+{
+	return is_nil(node) ? "nil" : texts[tokens[node]];
+}
+
+std::string FlatAst::to_string_tree(uint32_t node) const
+{
+	std::string out;
+	if (node < size())
+		append_tree(node, out);
+	return out;
+}
+
+void FlatAst::append_tree(uint32_t node, std::string &out) const
+{
+	auto child = first_children[node];
+	if (child == NONE)
+	{
+		out += to_string(node);
+		return;
+	}
+	if (!is_nil(node))
+	{
+		out += "(";
+		out += texts[tokens[node]];
+		out += " ";
+	}
+	for (; child != NONE; child = next_siblings[child])
+	{
+		if (child != first_children[node])
+			out += " ";
+		append_tree(child, out);
+	}
+	if (!is_nil(node))
+		out += ")";
+}
+
+size_t FlatAst::memory_bytes() const
+{
+	auto bytes = types.capacity() * sizeof(int32_t) + tokens.capacity() * sizeof(uint32_t)
+		+ first_children.capacity() * sizeof(uint32_t) + next_siblings.capacity() * sizeof(uint32_t)
+		+ texts.capacity() * sizeof(std::string);
+	for (const auto &text : texts)
+		bytes += text.capacity() + 1 > sizeof(std::string) ? text.capacity() + 1 : 0;
+	// one bucket pointer per bucket, a key/value node per text.
+	bytes += text_index.bucket_count() * sizeof(void*)
+		+ text_index.size() * (sizeof(std::string) + sizeof(uint32_t) + 2 * sizeof(void*));
+	return bytes;
+}
+
+
+bool FlatAst::Cursor::goto_first_child()
+{
+	auto child = tree->first_child(node);
+	if (child == NONE)
+		return false;
+	parents.push_back(node);
+	node = child;
+	return true;
+}
+
+bool FlatAst::Cursor::goto_next_sibling()
+{
+	auto sibling = tree->next_sibling(node);
+	if (parents.empty() || sibling == NONE)
+		return false;
+	node = sibling;
+	return true;
+}
+
+bool FlatAst::Cursor::goto_parent()
+{
+	if (parents.empty())
+		return false;
+	node = parents.back();
+	parents.pop_back();
+	return true;
+}
+
+bool FlatAst::Cursor::goto_next()
+{
+	if (goto_first_child())
+		return true;
+	do {
+		if (goto_next_sibling())
+			return true;
+	} while (goto_parent());
+	return false;
+}
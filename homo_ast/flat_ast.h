@@ -0,0 +1,143 @@
+#ifndef _FLAT_AST_H
+#define _FLAT_AST_H
+
+#include "ast.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The same homogeneous trees as Ast, stored as parallel arrays indexed by
+// node number. Nodes are numbered in preorder, so a walk over the tree
+// reads each array front to back:
+//
+//   types          token type of the node
+//   tokens         index into the token text pool, NONE for nil nodes
+//   first_child    NONE for leaves
+//   next_sibling   NONE for the last child
+//
+// Trees are built in preorder with begin_node/end_node, or copied from an
+// Ast with add_tree()/from_tree(). Several top-level nodes make a forest;
+// they are siblings of each other, the first one is node 0.
+class FlatAst
+{
+public:
+	static const uint32_t NONE = 0xffffffff;
+
+	class Cursor;
+	class ChildIterator;
+	class Children;
+
+	uint32_t begin_node(int type, const std::string &text);
+	uint32_t begin_node(int type);
+	uint32_t begin_nil();
+	void end_node();
+	uint32_t leaf(int type, const std::string &text);
+
+	// copies tree in as the next top-level node and returns its number.
+	uint32_t add_tree(const Ast *tree);
+	static FlatAst from_tree(const Ast *tree);
+
+	uint32_t size() const;
+	uint32_t root() const;
+	int get_node_type(uint32_t node) const;
+	bool is_nil(uint32_t node) const;
+	uint32_t first_child(uint32_t node) const;
+	uint32_t next_sibling(uint32_t node) const;
+	Children children(uint32_t node) const;
+	Cursor cursor(uint32_t node = 0) const;
+
+	std::string to_string(uint32_t node) const;
+	std::string to_string_tree(uint32_t node = 0) const;
+
+	// approximate heap bytes held by the arrays and the text pool.
+	size_t memory_bytes() const;
+
+private:
+	uint32_t add(int type, uint32_t token);
+	uint32_t intern(const std::string &text);
+	void append_tree(uint32_t node, std::string &out) const;
+
+	struct Open
+	{
+		uint32_t node;
+		uint32_t last_child;
+	};
+
+	std::vector<int32_t> types;
+	std::vector<uint32_t> tokens;
+	std::vector<uint32_t> first_children;
+	std::vector<uint32_t> next_siblings;
+
+	std::vector<std::string> texts;
+	std::unordered_map<std::string, uint32_t> text_index;
+
+	// the nodes whose children are being added; the bottom entry stands
+	// for the forest itself.
+	std::vector<Open> open = { Open{ NONE, NONE } };
+};
+
+
+// Iterates over the direct children of a node:
+//
+//   for (auto child : tree.children(node)) ...
+class FlatAst::ChildIterator
+{
+public:
+	ChildIterator(const FlatAst *tree, uint32_t node) : tree(tree), node(node) {}
+
+	uint32_t operator*() const { return node; }
+	ChildIterator &operator++() { node = tree->next_sibling(node); return *this; }
+	bool operator!=(const ChildIterator &other) const { return node != other.node; }
+	bool operator==(const ChildIterator &other) const { return node == other.node; }
+
+private:
+	const FlatAst *tree;
+	uint32_t node;
+};
+
+class FlatAst::Children
+{
+public:
+	Children(const FlatAst *tree, uint32_t first) : tree(tree), first(first) {}
+
+	ChildIterator begin() const { return ChildIterator(tree, first); }
+	ChildIterator end() const { return ChildIterator(tree, NONE); }
+
+private:
+	const FlatAst *tree;
+	uint32_t first;
+};
+
+
+// Walks a tree without recursion. The moves return false and stay put
+// when there is no such node:
+//
+//   auto c = tree.cursor();
+//   if (c.goto_first_child()) do { ... } while (c.goto_next_sibling());
+//   c.goto_parent();
+class FlatAst::Cursor
+{
+public:
+	Cursor(const FlatAst *tree, uint32_t node) : tree(tree), node(node) {}
+
+	uint32_t get_node() const { return node; }
+	int get_node_type() const { return tree->get_node_type(node); }
+	bool is_nil() const { return tree->is_nil(node); }
+	std::string to_string() const { return tree->to_string(node); }
+	size_t depth() const { return parents.size(); }
+
+	bool goto_first_child();
+	bool goto_next_sibling();
+	bool goto_parent();
+	// the next node in preorder below the cursor's starting node; false,
+	// back at the starting node, once the subtree is done.
+	bool goto_next();
+
+private:
+	const FlatAst *tree;
+	uint32_t node;
+	std::vector<uint32_t> parents;
+};
+
+#endif // !_FLAT_AST_H
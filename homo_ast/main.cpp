@@ -1,4 +1,7 @@
 #include "ast.h"
+#include "arena.h"
+#include "flat_ast.h"
+#include "ast_image.h"
 #include <iostream>
 
 int main()
@@ -16,6 +19,38 @@ int main()
 	list->add_child(new Ast(new AstToken(AstToken::INT, "1")));
 	list->add_child(new Ast(new AstToken(AstToken::INT, "2")));
 	std::cout << list->to_string_tree() << std::endl;
+
+	AstArena arena;
+	auto sum = arena.make_node(arena.make_token(AstToken::PLUS, "+"));
+	sum->add_child(arena.make_node(arena.make_token(AstToken::INT, "3")));
+	sum->add_child(arena.make_node(arena.make_token(AstToken::INT, "4")));
+	std::cout << sum->to_string_tree() << std::endl;
+
+	auto flat = FlatAst::from_tree(root);
+	std::cout << flat.to_string_tree() << std::endl;
+
+	FlatAst built;
+	built.begin_node(AstToken::PLUS, "+");
+	built.leaf(AstToken::INT, "5");
+	built.begin_node(AstToken::PLUS, "+");
+	built.leaf(AstToken::INT, "6");
+	built.leaf(AstToken::INT, "7");
+	built.end_node();
+	built.end_node();
+	auto cursor = built.cursor();
+	do {
+		std::cout << std::string(cursor.depth() * 2, ' ') << cursor.to_string() << std::endl;
+	} while (cursor.goto_next());
+	std::cout << built.to_string_tree() << std::endl;
+
+	auto image = AstImage::write(root);
+	auto view = AstImage(image.data(), image.size());
+	auto copy = view.to_tree();
+	std::cout << view.to_string_tree() << " " << copy->to_string_tree() << std::endl;
+	delete copy;
+
+	delete root;
+	delete list;
 	return 0;
 
 }
\ No newline at end of file
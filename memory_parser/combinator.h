@@ -0,0 +1,185 @@
+#pragma once
+#include "parser.h"
+
+// Header-only parser combinators for BackTrackParser.
+//
+// A rule is a type with a static `match(P &parser)` that either consumes
+// input and returns true, or leaves the parser where it found it and
+// returns false. Rules are composed with templates, so a whole grammar is
+// resolved at compile time and the calls inline into one function per
+// rule, in place of the hand-written element/match_element pairs.
+//
+//   Tok<T>            match one token of type T
+//   Seq<A, B, ...>    A then B then ...
+//   Alt<A, B, ...>    first of A, B, ... that matches (ordered choice)
+//   Star<A>           zero or more A
+//   Memoize<A, Id>    remember where A stopped at each start index while
+//                     speculating; Id picks the parser memo table
+//
+// speculate<R>() tests R and always rewinds; parse<R>() matches R and
+// commits the consumed tokens.
+
+namespace combinator {
+
+// A failing Tok consumes nothing, so it needs no mark/pop of its own as
+// BackTrackParser::match has: on its own or under Alt or Star it leaves
+// the parser where it was, and inside a Seq the Seq rewinds the tokens
+// matched before it.
+template<int Type>
+struct Tok
+{
+	template<class P>
+	static bool match(P &p)
+	{
+		if (p.LA(1) != Type)
+			return false;
+		p.consume();
+		return true;
+	}
+};
+
+
+template<class... Rules>
+struct Seq;
+
+template<>
+struct Seq<>
+{
+	template<class P>
+	static bool match_rest(P &)
+	{
+		return true;
+	}
+};
+
+template<class First, class... Rest>
+struct Seq<First, Rest...>
+{
+	template<class P>
+	static bool match(P &p)
+	{
+		p.mark();
+		if (!match_rest(p))
+		{
+			p.release();
+			return false;
+		}
+		p.pop();
+		return true;
+	}
+
+	template<class P>
+	static bool match_rest(P &p)
+	{
+		return First::match(p) && Seq<Rest...>::match_rest(p);
+	}
+};
+
+
+template<class... Rules>
+struct Alt;
+
+template<>
+struct Alt<>
+{
+	template<class P>
+	static bool match(P &)
+	{
+		return false;
+	}
+};
+
+template<class First, class... Rest>
+struct Alt<First, Rest...>
+{
+	template<class P>
+	static bool match(P &p)
+	{
+		return First::match(p) || Alt<Rest...>::match(p);
+	}
+};
+
+
+template<class Rule>
+struct Star
+{
+	template<class P>
+	static bool match(P &p)
+	{
+		while (Rule::match(p))
+			;
+		return true;
+	}
+};
+
+
+template<class Rule, int Id>
+struct Memoize
+{
+	template<class P>
+	static bool match(P &p)
+	{
+		if (!p.isSpeculating())
+			return Rule::match(p);
+
+		auto start = p.index();
+		const auto &memo = p.memo_table(Id);
+		auto res = memo.find(start);
+		if (res != memo.end())
+		{
+			if (res->second == P::FAILED)
+				return false;
+			p.seek(res->second);
+			return true;
+		}
+		auto success = Rule::match(p);
+		// the nested rules may have added memo tables, look it up again.
+		p.memo_table(Id).insert(std::make_pair(start, success ? p.index() : P::FAILED));
+		return success;
+	}
+};
+
+
+template<class Rule, class P>
+bool speculate(P &p)
+{
+	p.mark();
+	auto success = Rule::match(p);
+	p.release();
+	return success;
+}
+
+template<class Rule, class P>
+bool parse(P &p)
+{
+	return Rule::match(p);
+}
+
+
+// The list grammar of BackTrackParser:
+//
+//   stat     : list EOF | assign EOF
+//   assign   : list '=' list
+//   list     : '[' elements ']'
+//   elements : element (',' element)*
+//   element  : NAME '=' NAME | NAME | list
+namespace list_grammar {
+
+enum MemoId { LIST_MEMO = BackTrackParser::LIST_MEMO };
+
+struct List;
+using Element = Alt<
+	Seq<Tok<ListLexer::NAME>, Tok<ListLexer::EQUALS>, Tok<ListLexer::NAME>>,
+	Tok<ListLexer::NAME>,
+	List>;
+using Elements = Seq<Element, Star<Seq<Tok<ListLexer::COMMA>, Element>>>;
+struct ListRule : Seq<Tok<ListLexer::LBRACK>, Elements, Tok<ListLexer::RBRACK>> {};
+struct List : Memoize<ListRule, LIST_MEMO> {};
+using Assign = Seq<List, Tok<ListLexer::EQUALS>, List>;
+using Stat = Alt<
+	Seq<List, Tok<Lexer::LEOF_TYPE>>,
+	Seq<Assign, Tok<Lexer::LEOF_TYPE>>>;
+
+} // namespace list_grammar
+
+} // namespace combinator
@@ -1,4 +1,5 @@
 #include "parser.h"
+#include "combinator.h"
 #include <iostream>
 #include <cstdio>
 #include <vector>
@@ -20,6 +21,11 @@ int main()
 		auto lexer = ListLexer(s);
 		auto parser = BackTrackParser(lexer);
 		parser.stat();
+
+		auto lexer2 = ListLexer(s);
+		auto parser2 = BackTrackParser(lexer2);
+		auto ok = combinator::parse<combinator::list_grammar::Stat>(parser2);
+		std::cout << "combinator: " << (ok ? "ok" : "failed") << std::endl;
 	}
 	//auto lexer = ListLexer(s);
 
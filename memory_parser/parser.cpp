@@ -204,6 +204,10 @@ void ListParser::consume()
 
 
 const int BackTrackParser::FAILED;
+const int BackTrackParser::LIST_MEMO;
+const int BackTrackParser::ELEMENTS_MEMO;
+const int BackTrackParser::ELEMENT_MEMO;
+const int BackTrackParser::ASSIGN_MEMO;
 
 
 BackTrackParser::BackTrackParser(Lexer &input) 
@@ -239,7 +243,7 @@ bool BackTrackParser::match_stat()
 		release();
 		mark();
 	}
-	if(!success && match_assign() && match(ListLexer::LEOF_TYPE))
+	if(!success && match_memoized(ASSIGN_MEMO, &BackTrackParser::match_assign) && match(ListLexer::LEOF_TYPE))
 		success = true;
 	if (!success)
 		release();
@@ -396,7 +400,7 @@ bool BackTrackParser::elements()
 bool BackTrackParser::match_elements()
 {
 	mark();
-	auto success = match_element();
+	auto success = match_memoized(ELEMENT_MEMO, &BackTrackParser::match_element);
 	if (!success)
 	{
 		release();
@@ -408,7 +412,7 @@ bool BackTrackParser::match_elements()
 			release();
 			return false;
 		}
-		success = match_element();
+		success = match_memoized(ELEMENT_MEMO, &BackTrackParser::match_element);
 		if (!success)
 		{
 			release();
@@ -498,6 +502,8 @@ bool BackTrackParser::_list()
 
 bool BackTrackParser::match_list_new()
 {
+	if (memoize_all)
+		return match_memoized(LIST_MEMO, &BackTrackParser::match_list);
 	auto failed = false;
 	auto index = p;
 	if (isSpeculating() && already_parsed_rule(list_memo))
@@ -520,7 +526,7 @@ bool BackTrackParser::match_list()
 		release();
 		return false;
 	}
-	success = match_elements();
+	success = match_memoized(ELEMENTS_MEMO, &BackTrackParser::match_elements);
 	if (!success)
 	{
 		release();
@@ -544,9 +550,10 @@ bool BackTrackParser::already_parsed_rule(const std::unordered_map<int, int> &me
 		return false;
 	}
 	auto value = res->second;
-	std::cout << "parsed list before index " << p << " skip ahead to " << value << ": " << buff[value].getText() << std::endl;
 	if (value == FAILED)
 		return false;
+	if (trace)
+		std::cout << "parsed list before index " << p << " skip ahead to " << value << ": " << buff[value].getText() << std::endl;
 	seek(value);
 	return true;
 }
@@ -559,5 +566,89 @@ void BackTrackParser::memorize(std::unordered_map<int, int> &memo, int index, bo
 
 void BackTrackParser::clear_memo()
 {
+	size_t bytes = 0;
+	auto entries = memo_size(&bytes);
+	stats.entries += entries;
+	if (entries > stats.peak_entries)
+		stats.peak_entries = entries;
+	if (bytes > stats.peak_bytes)
+		stats.peak_bytes = bytes;
+
 	list_memo.clear();
+	for (auto &memo : memo_tables)
+		memo.clear();
+}
+
+// Entries in all memo tables, and an estimate of their heap footprint: one
+// node per entry (next pointer plus the pair) and the bucket array.
+size_t BackTrackParser::memo_size(size_t *bytes) const
+{
+	const size_t node = sizeof(void*) + sizeof(std::pair<const int, int>);
+	size_t entries = list_memo.size();
+	*bytes = list_memo.size() * node + list_memo.bucket_count() * sizeof(void*);
+	for (const auto &memo : memo_tables)
+	{
+		entries += memo.size();
+		*bytes += memo.size() * node + memo.bucket_count() * sizeof(void*);
+	}
+	return entries;
+}
+
+MemoStats BackTrackParser::memo_stats() const
+{
+	size_t bytes = 0;
+	auto entries = memo_size(&bytes);
+	auto res = stats;
+	res.entries += entries;
+	if (entries > res.peak_entries)
+		res.peak_entries = entries;
+	if (bytes > res.peak_bytes)
+		res.peak_bytes = bytes;
+	return res;
+}
+
+// With memoize_all every rule that runs while speculating records where it
+// stopped, so no rule is evaluated twice at the same token index and a
+// parse takes time linear in its input, at the cost of the memo tables.
+void BackTrackParser::set_memoize_all(bool on)
+{
+	memoize_all = on;
+}
+
+bool BackTrackParser::match_memoized(int rule, bool (BackTrackParser::*match_rule)())
+{
+	if (!memoize_all || !isSpeculating())
+		return (this->*match_rule)();
+
+	auto start = p;
+	const auto &memo = memo_table(rule);
+	auto res = memo.find(start);
+	if (res != memo.end())
+	{
+		if (res->second == FAILED)
+			return false;
+		seek(res->second);
+		return true;
+	}
+	auto success = (this->*match_rule)();
+	// the nested rules may have grown memo_tables, look the table up again.
+	memo_table(rule).insert(std::make_pair(start, success ? p : FAILED));
+	return success;
+}
+
+std::unordered_map<int, int> &BackTrackParser::memo_table(int rule)
+{
+	if (rule >= (int)memo_tables.size())
+		memo_tables.resize(rule + 1);
+	return memo_tables[rule];
+}
+
+int BackTrackParser::index() const
+{
+	return p;
+}
+
+void BackTrackParser::set_trace(bool on)
+{
+	trace = on;
 }
@@ -91,6 +91,15 @@ public:
 };
 
 
+// Memo table usage of a BackTrackParser. Tables are dropped whenever the
+// token buffer is reset, `peak_*` is the largest live footprint seen.
+struct MemoStats {
+	long long entries = 0;
+	size_t peak_entries = 0;
+	size_t peak_bytes = 0;
+};
+
+
 class BackTrackParser : public ListParser {
 public:
 	BackTrackParser(Lexer &input);
@@ -131,11 +140,29 @@ public:
 	bool already_parsed_rule(const std::unordered_map<int, int> &memo);
 	void memorize(std::unordered_map<int, int> &memo, int index, bool failed);
 	void clear_memo();
+	std::unordered_map<int, int> &memo_table(int rule);
+	int index() const;
+	void set_trace(bool on);
+
+	void set_memoize_all(bool on);
+	bool match_memoized(int rule, bool (BackTrackParser::*match_rule)());
+	MemoStats memo_stats() const;
+
+	static const int FAILED = -1;
+	static const int LIST_MEMO = 0;
+	static const int ELEMENTS_MEMO = 1;
+	static const int ELEMENT_MEMO = 2;
+	static const int ASSIGN_MEMO = 3;
 
 private:
 	std::vector<int> markers;
 	std::vector<Token> buff;
 	int p = 0;
 	std::unordered_map<int, int> list_memo;
-	static const int FAILED = -1;
+	std::vector<std::unordered_map<int, int>> memo_tables;
+	bool trace = true;
+	bool memoize_all = false;
+	MemoStats stats;
+
+	size_t memo_size(size_t *bytes) const;
 };
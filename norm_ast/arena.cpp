@@ -0,0 +1,90 @@
+#include "arena.h"
+#include <cstdint>
+
+AstArena::AstArena(size_t block_size)
+	: block_size(block_size)
+{}
+
+AstArena::~AstArena()
+{
+	clear();
+	for (auto block : blocks)
+		delete[] block;
+}
+
+AstToken *AstArena::make_token(int type, const std::string &text)
+{
+	return create<AstToken>(type, text);
+}
+
+AstToken *AstArena::make_token(int type)
+{
+	return create<AstToken>(type);
+}
+
+Ast *AstArena::make_node(AstToken *token)
+{
+	return create<Ast>(token);
+}
+
+Ast *AstArena::make_node(int type)
+{
+	return create<Ast>(make_token(type));
+}
+
+Ast *AstArena::make_nil()
+{
+	return create<Ast>();
+}
+
+void *AstArena::allocate(size_t size, size_t align)
+{
+	auto p = cur == nullptr ? 0 : (reinterpret_cast<std::uintptr_t>(cur) + align - 1) & ~(std::uintptr_t)(align - 1);
+	if (cur == nullptr || p + size > reinterpret_cast<std::uintptr_t>(end))
+	{
+		new_block(size + align);
+		p = (reinterpret_cast<std::uintptr_t>(cur) + align - 1) & ~(std::uintptr_t)(align - 1);
+	}
+	cur = reinterpret_cast<char*>(p + size);
+	used += size;
+	return reinterpret_cast<void*>(p);
+}
+
+void AstArena::clear()
+{
+	for (auto iter = finalizers.rbegin(); iter != finalizers.rend(); ++iter)
+		iter->destroy(iter->object);
+	finalizers.clear();
+
+	for (size_t i = 1; i < blocks.size(); ++i)
+		delete[] blocks[i];
+	if (!blocks.empty())
+		blocks.resize(1);
+	cur = blocks.empty() ? nullptr : blocks[0];
+	end = blocks.empty() ? nullptr : blocks[0] + block_size;
+	used = 0;
+}
+
+size_t AstArena::bytes_used() const
+{
+	return used;
+}
+
+void AstArena::detach(Ast *node)
+{
+	node->children.clear();
+	node->token = nullptr;
+}
+
+void AstArena::new_block(size_t size)
+{
+	// the first block is always block_size so clear() can keep it;
+	// oversized requests get a block of their own.
+	if (blocks.empty() && size > block_size)
+		new_block(block_size);
+	auto n = size > block_size ? size : block_size;
+	auto block = new char[n];
+	blocks.push_back(block);
+	cur = block;
+	end = block + n;
+}
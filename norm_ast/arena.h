@@ -0,0 +1,85 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include "ast.h"
+#include <cstddef>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Owns every node and token of a tree. Objects are placed by bumping a
+// pointer through large blocks and are all destroyed together by clear()
+// or the arena's destructor, never by delete:
+//
+//   AstArena arena;
+//   auto one = arena.create<IntNode>(arena.make_token(AstToken::INT, "1"));
+//   auto two = arena.create<IntNode>(arena.make_token(AstToken::INT, "2"));
+//   auto root = arena.create<AddNode>(one, arena.make_token(AstToken::PLUS, "+"), two);
+//
+// Arena nodes must only have arena children. Objects made with create<T>()
+// are finalized in reverse order of creation, unless T is trivially
+// destructible: then they are not remembered at all. Every node class
+// here owns a vector of children and a token with a string, so nodes and
+// tokens are always finalized.
+class AstArena
+{
+public:
+	AstArena(size_t block_size = 64 * 1024);
+	~AstArena();
+	AstArena(const AstArena&) = delete;
+	AstArena &operator=(const AstArena&) = delete;
+
+	AstToken *make_token(int type, const std::string &text);
+	AstToken *make_token(int type);
+	Ast *make_node(AstToken *token);
+	Ast *make_node(int type);
+	Ast *make_nil();
+
+	template<class T, class... Args>
+	T *create(Args&&... args)
+	{
+		auto object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		if (!std::is_trivially_destructible<T>::value)
+			finalizers.push_back(Finalizer{ &finalize<T>, object });
+		return object;
+	}
+
+	void *allocate(size_t size, size_t align);
+
+	// destroys everything, keeps the first block for reuse.
+	void clear();
+	size_t bytes_used() const;
+
+private:
+	struct Finalizer
+	{
+		void (*destroy)(void*);
+		void *object;
+	};
+
+	// ~Ast deletes its children and token; in the arena they belong to
+	// the arena, so they are dropped from the node before it is destroyed.
+	static void detach(Ast *node);
+	static void detach(const void*) {}
+
+	template<class T>
+	static void finalize(void *object)
+	{
+		auto p = static_cast<T*>(object);
+		detach(p);
+		p->~T();
+	}
+
+	void new_block(size_t size);
+
+	size_t block_size;
+	std::vector<char*> blocks;
+	char *cur = nullptr;
+	char *end = nullptr;
+	size_t used = 0;
+	std::vector<Finalizer> finalizers;
+};
+
+#endif // !_ARENA_H
@@ -1,6 +1,8 @@
 #ifndef _AST_H
 #define _AST_H
 
+#include "small_vector.h"
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -10,6 +12,7 @@ public:
 	AstToken(int type, const std::string &text);
 	AstToken(int type);
 	std::string to_string() const;
+	const std::string &get_text() const;
 	int get_type() const;
 
 	static const int INVALID_TOKEN_TYPE = 0;
@@ -36,10 +39,59 @@ public:
 	bool is_nil() const;
 	virtual std::string to_string() const;
 	std::string to_string_tree() const;
+	// appends to_string_tree() to out.
+	void to_string_tree(std::string &out) const;
+	// length of to_string_tree(), to size a buffer before writing.
+	size_t string_tree_size() const;
+
+	// Writes to_string_tree() into sink in one pass; a Sink has
+	// append(const char *s, size_t n), as std::string does.
+	template<class Sink>
+	void write_tree(Sink &sink) const
+	{
+		if (children.size() == 0)
+		{
+			write_text(sink);
+			return;
+		}
+		if (!is_nil())
+		{
+			sink.append("(", 1);
+			write_text(sink);
+			sink.append(" ", 1);
+		}
+		for (auto iter = children.cbegin(); iter != children.cend(); ++iter)
+		{
+			if (iter != children.cbegin())
+				sink.append(" ", 1);
+			(*iter)->write_tree(sink);
+		}
+		if (!is_nil())
+			sink.append(")", 1);
+	}
 
 protected:
+	// to_string() without building a string.
+	template<class Sink>
+	void write_text(Sink &sink) const
+	{
+		if (token == nullptr)
+			sink.append("nil", 3);
+		else
+			sink.append(token->get_text().data(), token->get_text().size());
+		auto suffix = text_suffix();
+		sink.append(suffix, std::strlen(suffix));
+	}
+	size_t text_size() const;
+	// what to_string() adds after the token text: nothing for an Ast.
+	virtual const char *text_suffix() const;
+
+	friend class AstArena;
+	friend class AstImage;
+
 	AstToken *token = nullptr;
-	std::vector<Ast*> children;
+	// binary operators keep both children inline.
+	SmallVector<Ast*, 2> children;
 
 };
 
@@ -57,6 +109,11 @@ public:
 	static const int tVEC = 2;
 
 protected:
+	// the type, once known.
+	const char *text_suffix() const override;
+
+	friend class AstImage;
+
 	int eval_type;
 };
 
@@ -1,4 +1,7 @@
 #include "ast.h"
+#include "arena.h"
+#include "ast_image.h"
+#include <cstring>
 #include <iostream>
 
 int main()
@@ -10,6 +13,39 @@ int main()
 	auto root = new AddNode(new IntNode(one), plus, new IntNode(two));
 	std::cout << root->to_string_tree() << std::endl;
 
+	AstArena arena;
+	auto three = arena.create<IntNode>(arena.make_token(AstToken::INT, "3"));
+	auto four = arena.create<IntNode>(arena.make_token(AstToken::INT, "4"));
+	auto sum = arena.create<AddNode>(three, arena.make_token(AstToken::PLUS, "+"), four);
+	std::cout << sum->to_string_tree() << std::endl;
+
+	auto image = AstImage::write(root);
+	auto view = AstImage(image.data(), image.size());
+	auto copy = view.to_tree();
+	std::cout << view.to_string_tree() << " " << copy->to_string_tree() << std::endl;
+	delete copy;
+
+	// 5 + [1, 2]: a reloaded tree writes the same image again.
+	auto nested = new AddNode(new IntNode(new AstToken(AstToken::INT, "5")), new AstToken(AstToken::PLUS, "+"),
+		new VecNode(nullptr, { new IntNode(new AstToken(AstToken::INT, "1")), new IntNode(new AstToken(AstToken::INT, "2")) }));
+	auto nested_image = AstImage::write(nested);
+	auto reloaded = AstImage(nested_image.data(), nested_image.size()).to_tree();
+	bool same = reloaded != nullptr && AstImage::write(reloaded) == nested_image
+		&& reloaded->to_string_tree() == nested->to_string_tree();
+	std::cout << "round trip " << (same ? "ok" : "differs") << ": " << nested->to_string_tree() << std::endl;
+	delete reloaded;
+	delete nested;
+
+	// a record whose children come before it would loop; the image is refused.
+	auto looped = image;
+	NodeRecord record;
+	auto at = reinterpret_cast<const ImageHeader*>(looped.data())->nodes_offset;
+	std::memcpy(&record, &looped[at], sizeof(record));
+	record.first_child = 0;
+	std::memcpy(&looped[at], &record, sizeof(record));
+	std::cout << "looped image " << (AstImage(looped.data(), looped.size()).is_valid() ? "accepted" : "refused") << std::endl;
+
+	delete root;
 
 	return 0;
 
@@ -0,0 +1,41 @@
+#ifndef _RECLAIMER_H
+#define _RECLAIMER_H
+
+#include "ast.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Frees trees on a background thread, so dropping a large tree costs the
+// caller one queue push instead of a walk over every node:
+//
+//   AstReclaimer reclaimer;
+//   reclaimer.reclaim(tree);    // in place of delete tree
+//
+// The destructor frees whatever is still queued before it returns.
+class AstReclaimer
+{
+public:
+	AstReclaimer();
+	~AstReclaimer();
+	AstReclaimer(const AstReclaimer&) = delete;
+	AstReclaimer &operator=(const AstReclaimer&) = delete;
+
+	void reclaim(Ast *tree);
+	// waits until every tree handed over so far has been freed.
+	void drain();
+
+private:
+	void run();
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	std::vector<Ast*> queue;
+	bool busy = false;
+	bool stop = false;
+	std::thread worker;
+};
+
+#endif // !_RECLAIMER_H
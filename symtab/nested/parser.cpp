@@ -143,6 +143,10 @@ Token CymbolLexer::nextToken()
 	return Token(LEOF_TYPE, "<EOF>");
 }
 
+TokenView::TokenView(const Token *first, const Token *last) :
+	first(first), last(last) { }
+
+
 Parser::Parser(Lexer &input) :
 	input(input) {
 }
@@ -174,7 +178,8 @@ Token SymbolParser::last_token()
 
 void SymbolParser::compile(SymbolTable *table)
 {
-	mactch_var_declaration(table);
+	while (LA(1) != Lexer::LEOF_TYPE && mactch_var_declaration(table))
+		;
 }
 
 bool SymbolParser::mactch_var_declaration(SymbolTable *table)
@@ -199,10 +204,9 @@ bool SymbolParser::mactch_var_declaration(SymbolTable *table)
 		release();
 		return false;
 	}
-	auto ptr = pop_buff();
-	auto line = *ptr;
+	auto line = pop_buff();
 
-	auto text = line[1].getText();
+	const auto &text = line[1].getText();
 	auto type = std::static_pointer_cast<BuiltinSymbol>(BuiltinSymbolTable::instance()->resolve(line[0].getText()));
 	auto vs = std::make_shared<VarSymbol>(text, type);
 	std::cout << "get new varsymbol, text: " << text << ", type: " << type->get_name() << std::endl;
@@ -211,7 +215,7 @@ bool SymbolParser::mactch_var_declaration(SymbolTable *table)
 }
 
 
-Token SymbolParser::LT(int i)
+const Token &SymbolParser::LT(int i)
 {
 	sync(i);
 	return buff[p + i - 1];
@@ -263,6 +267,8 @@ void SymbolParser::consume()
 
 int SymbolParser::mark()
 {
+	if (!isSpeculating())
+		compact_buff();
 	markers.push_back(p);
 	return p;
 }
@@ -274,27 +280,34 @@ void SymbolParser::release()
 	seek(marker);
 }
 
-std::vector<Token>* SymbolParser::pop_buff()
+// Pops the rule's marker and returns the tokens it matched. At the top
+// level the tokens are committed, but they are only dropped from the
+// buffer when the next rule starts, so the view can be used in between.
+TokenView SymbolParser::pop_buff()
 {
+	int start = markers.back();
 	markers.pop_back();
-	if (p + 1 == buff.size() && !isSpeculating())
-	{
-		p = 0;
-		auto ptr = new std::vector<Token>(buff);
-		buff.clear();
-		return ptr;
-	}
-	return nullptr;
+	if (!isSpeculating())
+		committed = p;
+	return TokenView(buff.data() + start, buff.data() + p);
 }
 
 void SymbolParser::pop()
 {
 	markers.pop_back();
-	if (p + 1 == buff.size() && !isSpeculating())
-	{
-		p = 0;
-		buff.clear();
-	}
+	if (!isSpeculating())
+		committed = p;
+}
+
+// Drops committed tokens, keeping the lookahead. Erasing from the front
+// reuses the buffer's storage, so steady-state parsing does not allocate.
+void SymbolParser::compact_buff()
+{
+	if (committed == 0)
+		return;
+	buff.erase(buff.begin(), buff.begin() + committed);
+	p -= committed;
+	committed = 0;
 }
 
 void SymbolParser::seek(int index)
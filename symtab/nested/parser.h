@@ -65,6 +65,24 @@ public:
 };
 
 
+// Non-owning view of a range of buffered tokens. A view handed to a rule
+// action stays valid until the parser starts its next rule.
+class TokenView {
+public:
+	TokenView() = default;
+	TokenView(const Token *first, const Token *last);
+	const Token &operator[](int i) const { return first[i]; }
+	int size() const { return int(last - first); }
+	bool empty() const { return first == last; }
+	const Token *begin() const { return first; }
+	const Token *end() const { return last; }
+
+private:
+	const Token *first = nullptr;
+	const Token *last = nullptr;
+};
+
+
 class Parser {
 public:
 	Parser(Lexer &input);
@@ -87,7 +105,7 @@ public:
 	void compile(SymbolTable *table);
 	bool mactch_var_declaration(SymbolTable *table);
 
-	Token LT(int i);
+	const Token &LT(int i);
 	int LA(int i);
 	bool match(int x) override;
 	void sync(int i);
@@ -95,10 +113,11 @@ public:
 	void consume() override;
 	int mark();
 	void release();
-	std::vector<Token>* pop_buff();
+	TokenView pop_buff();
 	void pop();
 	void seek(int index);
 	bool isSpeculating();
+	void compact_buff();
 
 	void init() override;
 	Token last_token();
@@ -109,6 +128,7 @@ private:
 	std::vector<int> markers;
 	std::vector<Token> buff;
 	int p = 0;
+	int committed = 0;
 	
 	
 };
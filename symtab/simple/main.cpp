@@ -8,8 +8,9 @@ int main()
 {
 	std::string s2 = "float b;";
 	std::string s1 = "int a = b;";
+	std::string s3 = "int c; float d = c; int e;";
 
-	std::vector<std::string> vec{ s1, s2 };
+	std::vector<std::string> vec{ s1, s2, s3 };
 
 
 	for (const auto &s : vec)
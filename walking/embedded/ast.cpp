@@ -21,6 +21,16 @@ AstToken::AstToken(int type)
 	: type(type)
 {}
 
+void *AstToken::operator new(size_t size)
+{
+	return NodePool::allocate(size);
+}
+
+void AstToken::operator delete(void *p, size_t size)
+{
+	NodePool::deallocate(p, size);
+}
+
 std::string AstToken::to_string() const
 {
 	return text;
@@ -45,6 +55,39 @@ Ast::~Ast()
 	delete token;
 }
 
+void *Ast::operator new(size_t size)
+{
+	return NodePool::allocate(size);
+}
+
+void Ast::operator delete(void *p, size_t size)
+{
+	NodePool::deallocate(p, size);
+}
+
+void Ast::detach_children(std::vector<Ast*> &)
+{}
+
+// Subtrees are freed from an explicit stack rather than by recursion: each
+// node's children are detached before it is deleted, so deep trees cannot
+// overflow the call stack. The stack is kept per thread and reused; the
+// nodes deleted from the loop have no children left and return at once.
+void Ast::release_children()
+{
+	static thread_local std::vector<Ast*> stack;
+	auto base = stack.size();
+	detach_children(stack);
+	while (stack.size() > base)
+	{
+		auto node = stack.back();
+		stack.pop_back();
+		if (node == nullptr)
+			continue;
+		node->detach_children(stack);
+		delete node;
+	}
+}
+
 std::string Ast::to_string() const
 {
 	return token != nullptr ? token->to_string() : "nil";
@@ -57,23 +100,37 @@ int Ast::get_node_type() const
 
 void Ast::print() const
 {
-	std::cout << to_string();
+	OutputSink out;
+	print_to(out);
+	out.flush();
+}
+
+void Ast::print_to(OutputSink &out) const
+{
+	out << to_string();
 }
 
 AddNode::AddNode(Ast *left, AstToken *add, Ast *right)
 	:Ast(add), left(left), right(right) {}
 
-void AddNode::print() const
+void AddNode::print_to(OutputSink &out) const
 {
-	left->print();
-	std::cout << " + ";
-	right->print();
+	left->print_to(out);
+	out << " + ";
+	right->print_to(out);
 }
 
 AddNode::~AddNode()
 {
-	delete left;
-	delete right;
+	release_children();
+}
+
+void AddNode::detach_children(std::vector<Ast*> &out)
+{
+	out.push_back(left);
+	out.push_back(right);
+	left = nullptr;
+	right = nullptr;
 }
 
 AssignNode::AssignNode(Ast *left, AstToken *assign, Ast *right)
@@ -81,15 +138,22 @@ AssignNode::AssignNode(Ast *left, AstToken *assign, Ast *right)
 
 AssignNode::~AssignNode()
 {
-	delete left;
-	delete right;
+	release_children();
 }
 
-void AssignNode::print() const
+void AssignNode::detach_children(std::vector<Ast*> &out)
 {
-	left->print();
-	std::cout << " = ";
-	right->print();
+	out.push_back(left);
+	out.push_back(right);
+	left = nullptr;
+	right = nullptr;
+}
+
+void AssignNode::print_to(OutputSink &out) const
+{
+	left->print_to(out);
+	out << " = ";
+	right->print_to(out);
 }
 
 
@@ -99,19 +163,53 @@ DotProductNode::DotProductNode(Ast *left, AstToken *dot, Ast *right)
 
 DotProductNode::~DotProductNode()
 {
-	delete left;
-	delete right;
+	release_children();
 }
 
-void DotProductNode::print() const
+void DotProductNode::detach_children(std::vector<Ast*> &out)
 {
-	left->print();
-	std::cout << " . ";
-	right->print();
+	out.push_back(left);
+	out.push_back(right);
+	left = nullptr;
+	right = nullptr;
 }
 
+void DotProductNode::print_to(OutputSink &out) const
+{
+	left->print_to(out);
+	out << " . ";
+	right->print_to(out);
+}
+
+// the literal text is only read here; the node prints its value.
 IntNode::IntNode(AstToken *token)
-	: Ast(token) {}
+	: Ast(token), value(parse(token->to_string())) {}
+
+IntNode::IntNode(int64_t value)
+	: Ast(AstToken::INT), value(value) {}
+
+int64_t IntNode::parse(const char *digits, size_t length)
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < length; ++i)
+		value = value * 10 + (digits[i] - '0');
+	return (int64_t)value;
+}
+
+int64_t IntNode::parse(const std::string &digits)
+{
+	return parse(digits.data(), digits.size());
+}
+
+std::string IntNode::to_string() const
+{
+	return std::to_string(value);
+}
+
+void IntNode::print_to(OutputSink &out) const
+{
+	out << value;
+}
 
 
 MultNode::MultNode(Ast *left, AstToken *mult, Ast *right)
@@ -119,17 +217,22 @@ MultNode::MultNode(Ast *left, AstToken *mult, Ast *right)
 
 MultNode::~MultNode()
 {
-	delete left;
-	delete right;
+	release_children();
 }
 
-void MultNode::print() const
+void MultNode::detach_children(std::vector<Ast*> &out)
 {
-	std::stringstream ss;
+	out.push_back(left);
+	out.push_back(right);
+	left = nullptr;
+	right = nullptr;
+}
 
-	left->print();
-	std::cout << " * ";
-	right->print();
+void MultNode::print_to(OutputSink &out) const
+{
+	left->print_to(out);
+	out << " * ";
+	right->print_to(out);
 }
 
 PrintNode::PrintNode(AstToken *pr, Ast *element)
@@ -137,13 +240,19 @@ PrintNode::PrintNode(AstToken *pr, Ast *element)
 
 PrintNode::~PrintNode()
 {
-	delete element;
+	release_children();
+}
+
+void PrintNode::detach_children(std::vector<Ast*> &out)
+{
+	out.push_back(element);
+	element = nullptr;
 }
 
-void PrintNode::print() const
+void PrintNode::print_to(OutputSink &out) const
 {
-	std::cout << "print ";
-	element->print();
+	out << "print ";
+	element->print_to(out);
 }
 
 StatListNode::StatListNode(const std::vector<Ast*> &elements)
@@ -154,16 +263,21 @@ StatListNode::StatListNode(const std::initializer_list<Ast*> &elements)
 
 StatListNode::~StatListNode()
 {
-	for (auto ele : elements)
-		delete ele;
+	release_children();
+}
+
+void StatListNode::detach_children(std::vector<Ast*> &out)
+{
+	out.insert(out.end(), elements.begin(), elements.end());
+	elements.clear();
 }
 
-void StatListNode::print() const
+void StatListNode::print_to(OutputSink &out) const
 {
 	for (auto ele : elements)
 	{
-		ele->print();
-		std::cout << std::endl;
+		ele->print_to(out);
+		out << '\n';
 	}
 }
 
@@ -171,7 +285,11 @@ VarNode::VarNode(AstToken *var)
 	: Ast(var) {}
 
 VecNode::VecNode(AstToken *token, std::vector<Ast*> &&elements)
-	: Ast(token), elements(std::forward<std::vector<Ast*>>(elements)) 
+	: Ast(token), elements(std::move(elements))
+{ }
+
+VecNode::VecNode(AstToken *token, Elements &&elements)
+	: Ast(token), elements(std::move(elements))
 { }
 
 VecNode::VecNode(AstToken *token, const std::initializer_list<Ast*> &elements)
@@ -180,19 +298,24 @@ VecNode::VecNode(AstToken *token, const std::initializer_list<Ast*> &elements)
 
 VecNode::~VecNode()
 {
-	for (auto ele : elements)
-		delete ele;
+	release_children();
+}
+
+void VecNode::detach_children(std::vector<Ast*> &out)
+{
+	out.insert(out.end(), elements.begin(), elements.end());
+	elements.clear();
 }
 
-void VecNode::print() const
+void VecNode::print_to(OutputSink &out) const
 {
-	std::cout << " [";
-	std::cout << to_string();
+	out << " [";
+	out << to_string();
 	for (auto ele : elements)
 	{
-		ele->print();
-		std::cout << ", ";
+		ele->print_to(out);
+		out << ", ";
 	}
-	std::cout << "] ";
+	out << "] ";
 }
 
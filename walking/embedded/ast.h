@@ -1,6 +1,10 @@
 #ifndef _AST_H
 #define _AST_H
 
+#include "node_pool.h"
+#include "output_sink.h"
+#include "small_vector.h"
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <sstream>
@@ -25,6 +29,9 @@ public:
 	AstToken(int type);
 	std::string to_string() const;
 	int get_type() const;
+	// storage from NodePool, as for nodes.
+	static void *operator new(size_t size);
+	static void operator delete(void *p, size_t size);
 
 private:
 	int type;
@@ -40,13 +47,24 @@ public:
 	Ast(AstToken *token);
 	Ast(int type);
 	virtual ~Ast();
+	// nodes and tokens take their storage from NodePool.
+	static void *operator new(size_t size);
+	static void operator delete(void *p, size_t size);
+
+	// moves the node's children to out and forgets them, so the node can
+	// be deleted without touching its subtree.
+	virtual void detach_children(std::vector<Ast*> &out);
 
 	int get_node_type() const;
 	virtual std::string to_string() const;
 
-	virtual void print() const;
+	// prints the tree to std::cout through a buffer flushed at the end.
+	void print() const;
+	virtual void print_to(OutputSink &out) const;
 
 protected:
+	void release_children();
+
 	AstToken *token = nullptr;
 };
 
@@ -56,7 +74,8 @@ class AddNode :public Ast
 public:
 	AddNode(Ast *left, AstToken *add, Ast *right);
 	~AddNode();
-	void print() const override;
+	void detach_children(std::vector<Ast*> &out) override;
+	void print_to(OutputSink &out) const override;
 
 private:
 	Ast *left;
@@ -68,7 +87,8 @@ class AssignNode : public Ast
 public:
 	AssignNode(Ast *left, AstToken *assign, Ast *right);
 	~AssignNode();
-	void print() const override;
+	void detach_children(std::vector<Ast*> &out) override;
+	void print_to(OutputSink &out) const override;
 
 private:
 	Ast *left;
@@ -80,7 +100,8 @@ class DotProductNode : public Ast
 public:
 	DotProductNode(Ast *left, AstToken *dot, Ast *right);
 	~DotProductNode();
-	void print() const override;
+	void detach_children(std::vector<Ast*> &out) override;
+	void print_to(OutputSink &out) const override;
 
 private:
 	Ast *left;
@@ -91,6 +112,16 @@ class IntNode :public Ast
 {
 public:
 	IntNode(AstToken *token);
+	IntNode(int64_t value);
+	std::string to_string() const override;
+	// the value of a run of decimal digits; wraps around like int64_t
+	// arithmetic, so the lexer and this class agree on every literal.
+	static int64_t parse(const char *digits, size_t length);
+	static int64_t parse(const std::string &digits);
+	void print_to(OutputSink &out) const override;
+
+private:
+	int64_t value;
 };
 
 class MultNode : public Ast
@@ -98,7 +129,8 @@ class MultNode : public Ast
 public:
 	MultNode(Ast *left, AstToken *mult, Ast *right);
 	~MultNode();
-	void print() const override;
+	void detach_children(std::vector<Ast*> &out) override;
+	void print_to(OutputSink &out) const override;
 
 private:
 	Ast *left;
@@ -110,7 +142,8 @@ class PrintNode : public Ast
 public:
 	PrintNode(AstToken *pr, Ast *element);
 	~PrintNode();
-	void print() const override;
+	void detach_children(std::vector<Ast*> &out) override;
+	void print_to(OutputSink &out) const override;
 
 private:
 	Ast *element;
@@ -122,10 +155,11 @@ public:
 	StatListNode(const std::vector<Ast*> &elements);
 	StatListNode(const std::initializer_list<Ast*> &elements);
 	~StatListNode();
-	void print() const override;
+	void detach_children(std::vector<Ast*> &out) override;
+	void print_to(OutputSink &out) const override;
 
 private:
-	std::vector<Ast*> elements;
+	SmallVector<Ast*, 4> elements;
 };
 
 class VarNode : public Ast
@@ -138,13 +172,18 @@ public:
 class VecNode : public Ast
 {
 public:
+	// up to four elements are stored in the node.
+	typedef SmallVector<Ast*, 4> Elements;
+
 	VecNode(AstToken *token, std::vector<Ast*> &&elements);
+	VecNode(AstToken *token, Elements &&elements);
 	VecNode(AstToken *token, const std::initializer_list<Ast*> &elements);
 	~VecNode();
-	void print() const;
+	void detach_children(std::vector<Ast*> &out) override;
+	void print_to(OutputSink &out) const override;
 
 private:
-	std::vector<Ast*> elements;
+	Elements elements;
 
 };
 
@@ -1,14 +1,11 @@
 #include "ast.h"
+#include "parser.h"
 
 
 
 IntNode* get_int_node(int i)
 {
-	std::stringstream ss;
-	ss << i;
-
-	auto node = new IntNode(new AstToken(AstToken::INT, ss.str()));
-	return node;
+	return new IntNode(i);
 }
 
 
@@ -34,6 +31,17 @@ int main()
 	stats.push_back(p);
 	auto stats_list = new StatListNode(stats);
 	stats_list->print();
+
+	// the same program, parsed from text
+	std::cout << "--------------------------------" << std::endl;
+	auto lexer = Lexer("x = 1 + 4; print x * [2, 3, 4]; a . b");
+	auto parser = Parser(lexer);
+	auto program = parser.program();
+	if (program != nullptr)
+		program->print();
+
+	delete program;
+	delete stats_list;
 	return 0;
 
 }
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "node_pool.h"
+#include <mutex>
+#include <new>
+#include <vector>
+
+const size_t NodePool::ALIGN;
+const size_t NodePool::MAX_SIZE;
+const size_t NodePool::CHUNK_SIZE;
+
+namespace
+{
+	// every chunk stays listed here, so none is lost when the thread
+	// whose lists held it exits.
+	std::mutex &chunks_mutex()
+	{
+		static auto mutex = new std::mutex;
+		return *mutex;
+	}
+
+	std::vector<void*> &chunks()
+	{
+		static auto all = new std::vector<void*>;
+		return *all;
+	}
+}
+
+#ifdef AST_NO_POOL
+
+void *NodePool::allocate(size_t size)
+{
+	return ::operator new(size);
+}
+
+void NodePool::deallocate(void *p, size_t size)
+{
+	::operator delete(p);
+}
+
+#else
+
+namespace
+{
+	const size_t CLASSES = NodePool::MAX_SIZE / NodePool::ALIGN;
+	// a thread keeps up to 2 * BATCH free items of a class, and items move
+	// between threads BATCH at a time.
+	const size_t BATCH = 64;
+
+	struct FreeItem
+	{
+		FreeItem *next;
+		// in the returned lists, the first item of the next batch.
+		FreeItem *next_batch;
+	};
+
+	static_assert(sizeof(FreeItem) <= NodePool::ALIGN, "a free item must fit the smallest class");
+
+	// trivially constructed and destroyed, so nodes may still be freed
+	// while a thread or the program is shutting down.
+	struct FreeLists
+	{
+		FreeItem *heads[CLASSES];
+		size_t counts[CLASSES];
+	};
+
+#ifdef AST_POOL_SHARED
+	FreeLists shared_lists;
+
+	std::mutex &lists_mutex()
+	{
+		static auto mutex = new std::mutex;
+		return *mutex;
+	}
+#else
+	thread_local FreeLists local_lists;
+
+	// batches given back by threads with more free items than they use,
+	// taken by threads that run out before they take a new chunk.
+	FreeItem *returned[CLASSES];
+
+	std::mutex &returned_mutex()
+	{
+		static auto mutex = new std::mutex;
+		return *mutex;
+	}
+#endif
+
+	size_t size_class(size_t size)
+	{
+		return (size + NodePool::ALIGN - 1) / NodePool::ALIGN - 1;
+	}
+
+	// cuts a new chunk into items of the class and puts them on its list.
+	void refill(FreeLists &lists, size_t cls)
+	{
+		auto item_size = (cls + 1) * NodePool::ALIGN;
+		auto chunk = static_cast<char*>(::operator new(NodePool::CHUNK_SIZE));
+		{
+			std::lock_guard<std::mutex> lock(chunks_mutex());
+			chunks().push_back(chunk);
+		}
+		for (auto p = chunk; p + item_size <= chunk + NodePool::CHUNK_SIZE; p += item_size)
+		{
+			auto item = reinterpret_cast<FreeItem*>(p);
+			item->next = lists.heads[cls];
+			lists.heads[cls] = item;
+			++lists.counts[cls];
+		}
+	}
+
+	void *pop(FreeLists &lists, size_t cls)
+	{
+		if (lists.heads[cls] == nullptr)
+			refill(lists, cls);
+		auto item = lists.heads[cls];
+		lists.heads[cls] = item->next;
+		--lists.counts[cls];
+		return item;
+	}
+
+	void push(FreeLists &lists, size_t cls, void *p)
+	{
+		auto item = static_cast<FreeItem*>(p);
+		item->next = lists.heads[cls];
+		lists.heads[cls] = item;
+		++lists.counts[cls];
+	}
+
+#ifndef AST_POOL_SHARED
+	void give(size_t cls, FreeItem *first)
+	{
+		std::lock_guard<std::mutex> lock(returned_mutex());
+		first->next_batch = returned[cls];
+		returned[cls] = first;
+	}
+
+	// hands BATCH items to the returned lists, keeping the BATCH most
+	// recently freed ones.
+	void give_batch(FreeLists &lists, size_t cls)
+	{
+		auto kept = lists.heads[cls];
+		for (size_t i = 1; i < BATCH; ++i)
+			kept = kept->next;
+		auto first = kept->next;
+		auto last = first;
+		for (size_t i = 1; i < BATCH; ++i)
+			last = last->next;
+		kept->next = last->next;
+		last->next = nullptr;
+		lists.counts[cls] -= BATCH;
+		give(cls, first);
+	}
+
+	// the thread's list of the class must be empty.
+	bool take_batch(FreeLists &lists, size_t cls)
+	{
+		FreeItem *first;
+		{
+			std::lock_guard<std::mutex> lock(returned_mutex());
+			first = returned[cls];
+			if (first == nullptr)
+				return false;
+			returned[cls] = first->next_batch;
+		}
+		size_t count = 0;
+		for (auto item = first; item != nullptr; item = item->next)
+			++count;
+		lists.heads[cls] = first;
+		lists.counts[cls] = count;
+		return true;
+	}
+
+	// gives every free item of an exiting thread back.
+	struct ReturnAtExit
+	{
+		~ReturnAtExit()
+		{
+			for (size_t cls = 0; cls < CLASSES; ++cls)
+			{
+				if (local_lists.heads[cls] == nullptr)
+					continue;
+				give(cls, local_lists.heads[cls]);
+				local_lists.heads[cls] = nullptr;
+				local_lists.counts[cls] = 0;
+			}
+		}
+	};
+
+	thread_local ReturnAtExit return_at_exit;
+#endif
+}
+
+void *NodePool::allocate(size_t size)
+{
+	if (size > MAX_SIZE)
+		return ::operator new(size);
+#ifdef AST_POOL_SHARED
+	std::lock_guard<std::mutex> lock(lists_mutex());
+	return pop(shared_lists, size_class(size));
+#else
+	auto cls = size_class(size);
+	if (local_lists.heads[cls] == nullptr)
+	{
+		(void)return_at_exit;
+		take_batch(local_lists, cls);
+	}
+	return pop(local_lists, cls);
+#endif
+}
+
+void NodePool::deallocate(void *p, size_t size)
+{
+	if (p == nullptr)
+		return;
+	if (size > MAX_SIZE)
+	{
+		::operator delete(p);
+		return;
+	}
+#ifdef AST_POOL_SHARED
+	std::lock_guard<std::mutex> lock(lists_mutex());
+	push(shared_lists, size_class(size), p);
+#else
+	auto cls = size_class(size);
+	push(local_lists, cls, p);
+	if (local_lists.counts[cls] > 2 * BATCH)
+	{
+		(void)return_at_exit;
+		give_batch(local_lists, cls);
+	}
+#endif
+}
+
+#endif
+
+size_t NodePool::chunk_count()
+{
+	std::lock_guard<std::mutex> lock(chunks_mutex());
+	return chunks().size();
+}
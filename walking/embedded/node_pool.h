@@ -0,0 +1,38 @@
+#ifndef _NODE_POOL_H
+#define _NODE_POOL_H
+
+#include <cstddef>
+
+// Recycles the storage of nodes and tokens. Ast and AstToken allocate
+// through it, so a freed node goes onto a free list for its size class
+// and the next node of about the same size reuses it without malloc.
+//
+// Each thread has its own free lists unless the program is built with
+// AST_POOL_SHARED, which makes one set of lists behind a mutex. A thread
+// keeps a bounded number of free items per size class and gives the rest
+// back, a batch at a time, to lists shared by all threads; a thread that
+// runs out takes a batch from there before it takes a new chunk. So
+// storage freed on another thread than the one that allocated it (a tree
+// handed to AstReclaimer, say) is reused, and an exiting thread gives
+// back all it holds. Build with AST_NO_POOL to use plain new and delete,
+// e.g. when looking for use-after-free bugs with a sanitizer.
+//
+// Storage is taken from the heap in chunks that are kept for the rest
+// of the process; a pool grows to the most nodes alive at once plus the
+// items each thread keeps.
+class NodePool
+{
+public:
+	static void *allocate(size_t size);
+	static void deallocate(void *p, size_t size);
+
+	// chunks taken from the heap so far, by all threads.
+	static size_t chunk_count();
+
+	static const size_t ALIGN = 16;
+	// larger objects bypass the pool.
+	static const size_t MAX_SIZE = 256;
+	static const size_t CHUNK_SIZE = 16 * 1024;
+};
+
+#endif // !_NODE_POOL_H
@@ -0,0 +1,46 @@
+#include "output_sink.h"
+
+OutputSink::OutputSink(std::ostream &out, size_t capacity)
+	: out(out), buffer(capacity == 0 ? 1 : capacity)
+{}
+
+OutputSink::~OutputSink()
+{
+	flush();
+}
+
+// digits are written backwards into a local buffer, so printing a number
+// makes no temporary string.
+OutputSink &OutputSink::operator<<(int64_t value)
+{
+	char digits[20];
+	auto end = digits + sizeof(digits);
+	auto p = end;
+	auto v = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+	do {
+		*--p = (char)('0' + v % 10);
+		v /= 10;
+	} while (v != 0);
+	if (value < 0)
+		*--p = '-';
+	append(p, end - p);
+	return *this;
+}
+
+void OutputSink::flush()
+{
+	write_buffer();
+	out.flush();
+}
+
+size_t OutputSink::size() const
+{
+	return used;
+}
+
+void OutputSink::write_buffer()
+{
+	if (used != 0)
+		out.write(buffer.data(), used);
+	used = 0;
+}
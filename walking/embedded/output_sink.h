@@ -0,0 +1,76 @@
+#ifndef _OUTPUT_SINK_H
+#define _OUTPUT_SINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Collects printed text in one contiguous buffer and hands it to the
+// stream in large writes: when the buffer is full, on flush() and when
+// the sink is destroyed. The walkers print many short pieces per node;
+// through a sink they cost a memcpy each instead of a stream call.
+class OutputSink
+{
+public:
+	OutputSink(std::ostream &out = std::cout, size_t capacity = 64 * 1024);
+	~OutputSink();
+	OutputSink(const OutputSink&) = delete;
+	OutputSink &operator=(const OutputSink&) = delete;
+
+	void append(const char *s, size_t n)
+	{
+		if (n > buffer.size() - used)
+		{
+			write_buffer();
+			if (n > buffer.size())
+			{
+				out.write(s, n);
+				return;
+			}
+		}
+		std::memcpy(buffer.data() + used, s, n);
+		used += n;
+	}
+
+	OutputSink &operator<<(const std::string &s)
+	{
+		append(s.data(), s.size());
+		return *this;
+	}
+
+	OutputSink &operator<<(const char *s)
+	{
+		append(s, std::strlen(s));
+		return *this;
+	}
+
+	OutputSink &operator<<(char c)
+	{
+		append(&c, 1);
+		return *this;
+	}
+
+	OutputSink &operator<<(int64_t value);
+
+	OutputSink &operator<<(int value)
+	{
+		return *this << (int64_t)value;
+	}
+
+	// writes out everything buffered and flushes the stream.
+	void flush();
+	// bytes waiting in the buffer.
+	size_t size() const;
+
+private:
+	void write_buffer();
+
+	std::ostream &out;
+	std::vector<char> buffer;
+	size_t used = 0;
+};
+
+#endif // !_OUTPUT_SINK_H
@@ -0,0 +1,182 @@
+#ifndef _SMALL_VECTOR_H
+#define _SMALL_VECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// A vector whose first N items live inside the object itself; only a
+// longer list goes to the heap. Most nodes have a handful of children,
+// so they are built without any allocation besides the node.
+//
+// Meant for child pointers: T must be trivially copyable, items are moved
+// with memcpy and never destroyed one by one.
+template<class T, size_t N>
+class SmallVector
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SmallVector holds trivially copyable items only");
+	static_assert(N > 0, "SmallVector needs some inline capacity");
+
+public:
+	typedef T value_type;
+	typedef T *iterator;
+	typedef const T *const_iterator;
+
+	SmallVector() = default;
+
+	SmallVector(std::initializer_list<T> items)
+	{
+		assign(items.begin(), items.size());
+	}
+
+	SmallVector(const std::vector<T> &items)
+	{
+		assign(items.data(), items.size());
+	}
+
+	// takes the items and leaves `items` empty, as a moved-from vector.
+	// A std::vector buffer cannot be adopted, so a list longer than N
+	// is copied into a buffer of our own.
+	SmallVector(std::vector<T> &&items)
+	{
+		assign(items.data(), items.size());
+		items.clear();
+	}
+
+	SmallVector(const SmallVector &other)
+	{
+		assign(other.items, other.count);
+	}
+
+	SmallVector(SmallVector &&other)
+	{
+		take(other);
+	}
+
+	~SmallVector()
+	{
+		if (!is_inline())
+			::operator delete(items);
+	}
+
+	SmallVector &operator=(const SmallVector &other)
+	{
+		if (this != &other)
+		{
+			clear();
+			assign(other.items, other.count);
+		}
+		return *this;
+	}
+
+	SmallVector &operator=(SmallVector &&other)
+	{
+		if (this != &other)
+		{
+			if (!is_inline())
+				::operator delete(items);
+			items = inline_items;
+			count = 0;
+			cap = N;
+			take(other);
+		}
+		return *this;
+	}
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	size_t capacity() const { return cap; }
+	// true while the items are stored in the object.
+	bool is_inline() const { return items == inline_items; }
+
+	T *data() { return items; }
+	const T *data() const { return items; }
+	iterator begin() { return items; }
+	iterator end() { return items + count; }
+	const_iterator begin() const { return items; }
+	const_iterator end() const { return items + count; }
+	const_iterator cbegin() const { return items; }
+	const_iterator cend() const { return items + count; }
+
+	T &operator[](size_t i) { return items[i]; }
+	const T &operator[](size_t i) const { return items[i]; }
+	T &back() { return items[count - 1]; }
+	const T &back() const { return items[count - 1]; }
+
+	void push_back(const T &item)
+	{
+		if (count == cap)
+		{
+			// item may point into the buffer that grow() frees.
+			T copy = item;
+			grow(cap * 2);
+			items[count++] = copy;
+			return;
+		}
+		items[count++] = item;
+	}
+
+	void pop_back()
+	{
+		--count;
+	}
+
+	// keeps the heap buffer, if any, for reuse.
+	void clear()
+	{
+		count = 0;
+	}
+
+	void reserve(size_t n)
+	{
+		if (n > cap)
+			grow(n);
+	}
+
+private:
+	void assign(const T *from, size_t n)
+	{
+		reserve(n);
+		if (n != 0)
+			std::memcpy(items, from, n * sizeof(T));
+		count = (uint32_t)n;
+	}
+
+	// steals other's heap buffer, or copies its inline items.
+	void take(SmallVector &other)
+	{
+		if (other.is_inline())
+			assign(other.items, other.count);
+		else
+		{
+			items = other.items;
+			count = other.count;
+			cap = other.cap;
+			other.items = other.inline_items;
+			other.cap = N;
+		}
+		other.count = 0;
+	}
+
+	void grow(size_t n)
+	{
+		auto bigger = static_cast<T*>(::operator new(n * sizeof(T)));
+		if (count != 0)
+			std::memcpy(bigger, items, count * sizeof(T));
+		if (!is_inline())
+			::operator delete(items);
+		items = bigger;
+		cap = (uint32_t)n;
+	}
+
+	T *items = inline_items;
+	uint32_t count = 0;
+	uint32_t cap = N;
+	T inline_items[N];
+};
+
+#endif // !_SMALL_VECTOR_H
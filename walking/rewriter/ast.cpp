@@ -1,5 +1,6 @@
 
 #include "ast.h"
+#include <functional>
 
 const int AstToken::INVALID_TOKEN_TYPE;
 const int AstToken::PLUS;
@@ -22,6 +23,16 @@ AstToken::AstToken(int type)
 	: type(type)
 {}
 
+void *AstToken::operator new(size_t size)
+{
+	return NodePool::allocate(size);
+}
+
+void AstToken::operator delete(void *p, size_t size)
+{
+	NodePool::deallocate(p, size);
+}
+
 std::string AstToken::to_string() const
 {
 	return text;
@@ -37,13 +48,26 @@ void AstToken::set_text(const std::string &str)
 	text = str;
 }
 
+static AstToken *copy_token(const AstToken *token)
+{
+	return token != nullptr ? new AstToken(*token) : nullptr;
+}
+
+static Ast *retained(Ast *node)
+{
+	return node != nullptr ? node->retain() : nullptr;
+}
+
 Ast::Ast(AstToken *token)
 	: token(token)
-{}
+{
+	rehash();
+}
 
 Ast::Ast(int type)
 { 
 	token = new AstToken(type);
+	rehash();
 }
 
 Ast::~Ast()
@@ -51,6 +75,130 @@ Ast::~Ast()
 	delete token;
 }
 
+void *Ast::operator new(size_t size)
+{
+	return NodePool::allocate(size);
+}
+
+void Ast::operator delete(void *p, size_t size)
+{
+	NodePool::deallocate(p, size);
+}
+
+void Ast::detach_children(std::vector<Ast*> &)
+{}
+
+// Subtrees are freed from an explicit stack rather than by recursion: each
+// node's children are detached before it is deleted, so deep trees cannot
+// overflow the call stack. The stack is kept per thread and reused; the
+// nodes deleted from the loop have no children left and return at once.
+void Ast::release_children()
+{
+	static thread_local std::vector<Ast*> stack;
+	auto base = stack.size();
+	detach_children(stack);
+	while (stack.size() > base)
+	{
+		auto node = stack.back();
+		stack.pop_back();
+		if (node == nullptr || --node->refs > 0)
+			continue;
+		node->detach_children(stack);
+		delete node;
+	}
+}
+
+Ast *Ast::retain()
+{
+	++refs;
+	return this;
+}
+
+void Ast::release(Ast *node)
+{
+	if (node != nullptr && --node->refs == 0)
+		delete node;
+}
+
+int Ast::get_refs() const
+{
+	return refs;
+}
+
+size_t Ast::get_hash() const
+{
+	return hash;
+}
+
+void Ast::rehash()
+{
+	auto h = label_hash();
+	for (size_t i = 0; i < child_count(); ++i)
+	{
+		auto c = child(i);
+		h = h * 1000003 ^ (c != nullptr ? c->hash : 0);
+	}
+	hash = h;
+}
+
+size_t Ast::label_hash() const
+{
+	if (token == nullptr)
+		return 0;
+	return std::hash<std::string>()(token->to_string()) * 31 + token->get_type();
+}
+
+bool Ast::same_label(const Ast *other) const
+{
+	if (token == nullptr || other->token == nullptr)
+		return token == other->token;
+	return token->get_type() == other->token->get_type() && token->to_string() == other->token->to_string();
+}
+
+// the pairs still to compare are pushed as two entries, a node of each
+// tree, onto a stack that only leaves the frame for large subtrees.
+bool Ast::same(const Ast *a, const Ast *b)
+{
+	SmallVector<const Ast*, 16> stack = { a, b };
+	while (!stack.empty())
+	{
+		auto y = stack.back();
+		stack.pop_back();
+		auto x = stack.back();
+		stack.pop_back();
+		if (x == y)
+			continue;
+		if (x == nullptr || y == nullptr || x->hash != y->hash)
+			return false;
+		if (!x->same_label(y) || x->child_count() != y->child_count())
+			return false;
+		for (size_t i = 0; i < x->child_count(); ++i)
+		{
+			stack.push_back(x->child(i));
+			stack.push_back(y->child(i));
+		}
+	}
+	return true;
+}
+
+size_t Ast::child_count() const
+{
+	return 0;
+}
+
+Ast *Ast::child(size_t) const
+{
+	return nullptr;
+}
+
+void Ast::set_child(size_t, Ast *)
+{}
+
+Ast *Ast::shallow_copy() const
+{
+	return new Ast(copy_token(token));
+}
+
 std::string Ast::to_string() const
 {
 	return token != nullptr ? token->to_string() : "nil";
@@ -64,221 +212,520 @@ int Ast::get_node_type() const
 void Ast::visit(AstVisitor *visitor) const
 {
 	visitor->visit(this);
+	visitor->flush();
 }
 
 AddNode::AddNode(Ast *left, AstToken *add, Ast *right)
-	:Ast(add), left(left), right(right) {}
+	:Ast(add), left(left), right(right)
+{
+	rehash();
+}
 
 
 AddNode::~AddNode()
 {
-	delete left;
-	delete right;
+	release_children();
+}
+
+void AddNode::detach_children(std::vector<Ast*> &out)
+{
+	out.push_back(left);
+	out.push_back(right);
+	left = nullptr;
+	right = nullptr;
+}
+
+size_t AddNode::child_count() const
+{
+	return 2;
+}
+
+Ast *AddNode::child(size_t i) const
+{
+	return i == 0 ? left : right;
+}
+
+void AddNode::set_child(size_t i, Ast *node)
+{
+	if (i == 0)
+		left = node;
+	else
+		right = node;
+}
+
+Ast *AddNode::shallow_copy() const
+{
+	return new AddNode(retained(left), copy_token(token), retained(right));
 }
 
 AssignNode::AssignNode(Ast *left, AstToken *assign, Ast *right)
-	: Ast(assign), left(left), right(right) {}
+	: Ast(assign), left(left), right(right)
+{
+	rehash();
+}
 
 AssignNode::~AssignNode()
 {
-	delete left;
-	delete right;
+	release_children();
+}
+
+void AssignNode::detach_children(std::vector<Ast*> &out)
+{
+	out.push_back(left);
+	out.push_back(right);
+	left = nullptr;
+	right = nullptr;
+}
+
+size_t AssignNode::child_count() const
+{
+	return 2;
+}
+
+Ast *AssignNode::child(size_t i) const
+{
+	return i == 0 ? left : right;
+}
+
+void AssignNode::set_child(size_t i, Ast *node)
+{
+	if (i == 0)
+		left = node;
+	else
+		right = node;
+}
+
+Ast *AssignNode::shallow_copy() const
+{
+	return new AssignNode(retained(left), copy_token(token), retained(right));
 }
 
 
 DotProductNode::DotProductNode(Ast *left, AstToken *dot, Ast *right)
-	: Ast(dot), left(left), right(right) {}
+	: Ast(dot), left(left), right(right)
+{
+	rehash();
+}
 
 
 DotProductNode::~DotProductNode()
 {
-	delete left;
-	delete right;
+	release_children();
+}
+
+void DotProductNode::detach_children(std::vector<Ast*> &out)
+{
+	out.push_back(left);
+	out.push_back(right);
+	left = nullptr;
+	right = nullptr;
+}
+
+size_t DotProductNode::child_count() const
+{
+	return 2;
 }
 
+Ast *DotProductNode::child(size_t i) const
+{
+	return i == 0 ? left : right;
+}
+
+void DotProductNode::set_child(size_t i, Ast *node)
+{
+	if (i == 0)
+		left = node;
+	else
+		right = node;
+}
+
+Ast *DotProductNode::shallow_copy() const
+{
+	return new DotProductNode(retained(left), copy_token(token), retained(right));
+}
+
+// the literal text is only read here; the node prints its value.
 IntNode::IntNode(AstToken *token)
-	: Ast(token) {}
+	: Ast(token), value(parse(token->to_string()))
+{
+	rehash();
+}
+
+IntNode::IntNode(int64_t value)
+	: Ast(AstToken::INT), value(value)
+{
+	rehash();
+}
+
+int64_t IntNode::parse(const char *digits, size_t length)
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < length; ++i)
+		value = value * 10 + (digits[i] - '0');
+	return (int64_t)value;
+}
+
+int64_t IntNode::parse(const std::string &digits)
+{
+	return parse(digits.data(), digits.size());
+}
+
+std::string IntNode::to_string() const
+{
+	return std::to_string(value);
+}
 
 bool IntNode::is_zero() const
 {
-	return to_string() == "0";
+	return value == 0;
 }
 
-void IntNode::set_value(const std::string &value)
+void IntNode::set_value(int64_t value)
 {
-	token->set_text(value);
+	this->value = value;
+	rehash();
+}
+
+bool IntNode::same_label(const Ast *other) const
+{
+	auto n = dynamic_cast<const IntNode*>(other);
+	return n != nullptr && n->value == value;
+}
+
+Ast *IntNode::shallow_copy() const
+{
+	return new IntNode(value);
+}
+
+size_t IntNode::label_hash() const
+{
+	return std::hash<int64_t>()(value) * 31 + AstToken::INT;
 }
 
 
 MultNode::MultNode(Ast *left, AstToken *mult, Ast *right)
-	: Ast(mult), left(left), right(right) {}
+	: Ast(mult), left(left), right(right)
+{
+	rehash();
+}
 
 MultNode::~MultNode()
 {
-	delete left;
-	delete right;
+	release_children();
+}
+
+void MultNode::detach_children(std::vector<Ast*> &out)
+{
+	out.push_back(left);
+	out.push_back(right);
+	left = nullptr;
+	right = nullptr;
+}
+
+size_t MultNode::child_count() const
+{
+	return 2;
+}
+
+Ast *MultNode::child(size_t i) const
+{
+	return i == 0 ? left : right;
+}
+
+void MultNode::set_child(size_t i, Ast *node)
+{
+	if (i == 0)
+		left = node;
+	else
+		right = node;
+}
+
+Ast *MultNode::shallow_copy() const
+{
+	return new MultNode(retained(left), copy_token(token), retained(right));
 }
 
 
 PrintNode::PrintNode(AstToken *pr, Ast *element)
-	:Ast(pr), element(element) {}
+	:Ast(pr), element(element)
+{
+	rehash();
+}
 
 PrintNode::~PrintNode()
 {
-	delete element;
+	release_children();
+}
+
+void PrintNode::detach_children(std::vector<Ast*> &out)
+{
+	out.push_back(element);
+	element = nullptr;
+}
+
+size_t PrintNode::child_count() const
+{
+	return 1;
+}
+
+Ast *PrintNode::child(size_t) const
+{
+	return element;
+}
+
+void PrintNode::set_child(size_t, Ast *node)
+{
+	element = node;
+}
+
+Ast *PrintNode::shallow_copy() const
+{
+	return new PrintNode(copy_token(token), retained(element));
 }
 
 
 StatListNode::StatListNode(const std::vector<Ast*> &elements)
-	: Ast(AstToken::STAT_LIST), elements(elements) {}
+	: Ast(AstToken::STAT_LIST), elements(elements)
+{
+	rehash();
+}
 
 StatListNode::StatListNode(const std::initializer_list<Ast*> &elements)
-	: Ast(nullptr), elements(elements) {}
+	: Ast(nullptr), elements(elements)
+{
+	rehash();
+}
 
 StatListNode::~StatListNode()
 {
-	for (auto ele : elements)
-		delete ele;
+	release_children();
+}
+
+void StatListNode::detach_children(std::vector<Ast*> &out)
+{
+	out.insert(out.end(), elements.begin(), elements.end());
+	elements.clear();
+}
+
+size_t StatListNode::child_count() const
+{
+	return elements.size();
+}
+
+Ast *StatListNode::child(size_t i) const
+{
+	return elements[i];
+}
+
+void StatListNode::set_child(size_t i, Ast *node)
+{
+	elements[i] = node;
+}
+
+Ast *StatListNode::shallow_copy() const
+{
+	std::vector<Ast*> copy;
+	for (auto element : elements)
+		copy.push_back(retained(element));
+	return new StatListNode(copy);
 }
 
 
 VarNode::VarNode(AstToken *var)
-	: Ast(var) {}
+	: Ast(var)
+{
+	rehash();
+}
+
+Ast *VarNode::shallow_copy() const
+{
+	return new VarNode(copy_token(token));
+}
 
 VecNode::VecNode(AstToken *token, std::vector<Ast*> &&elements)
-	: Ast(token), elements(std::forward<std::vector<Ast*>>(elements)) 
-{ }
+	: Ast(token), elements(std::move(elements))
+{
+	rehash();
+}
+
+VecNode::VecNode(AstToken *token, Elements &&elements)
+	: Ast(token), elements(std::move(elements))
+{
+	rehash();
+}
 
 VecNode::VecNode(AstToken *token, const std::initializer_list<Ast*> &elements)
 	: Ast(token), elements(elements)
-{ }
+{
+	rehash();
+}
 
 VecNode::~VecNode()
 {
-	for (auto ele : elements)
-		delete ele;
+	release_children();
+}
+
+void VecNode::detach_children(std::vector<Ast*> &out)
+{
+	out.insert(out.end(), elements.begin(), elements.end());
+	elements.clear();
+}
+
+size_t VecNode::child_count() const
+{
+	return elements.size();
+}
+
+Ast *VecNode::child(size_t i) const
+{
+	return elements[i];
+}
+
+void VecNode::set_child(size_t i, Ast *node)
+{
+	elements[i] = node;
+}
+
+Ast *VecNode::shallow_copy() const
+{
+	Elements copy;
+	for (auto element : elements)
+		copy.push_back(retained(element));
+	return new VecNode(copy_token(token), std::move(copy));
 }
 
 LeftShiftNode::LeftShiftNode(Ast *left, AstToken *shift, Ast *right)
-	: Ast(shift), left(left), right(right) { }
+	: Ast(shift), left(left), right(right)
+{
+	rehash();
+}
 
 LeftShiftNode::~LeftShiftNode()
 {
-	delete left;
-	delete right;
+	release_children();
+}
+
+void LeftShiftNode::detach_children(std::vector<Ast*> &out)
+{
+	out.push_back(left);
+	out.push_back(right);
+	left = nullptr;
+	right = nullptr;
+}
+
+size_t LeftShiftNode::child_count() const
+{
+	return 2;
 }
 
+Ast *LeftShiftNode::child(size_t i) const
+{
+	return i == 0 ? left : right;
+}
+
+void LeftShiftNode::set_child(size_t i, Ast *node)
+{
+	if (i == 0)
+		left = node;
+	else
+		right = node;
+}
+
+Ast *LeftShiftNode::shallow_copy() const
+{
+	return new LeftShiftNode(retained(left), copy_token(token), retained(right));
+}
+
+
+AstVisitor::AstVisitor(std::ostream &out)
+	: out(out)
+{}
+
+void AstVisitor::flush() const
+{
+	out.flush();
+}
 
 void AstVisitor::visit(const Ast *node) const
 {
-	Ast *n = const_cast<Ast*>(node);
-	switch (node->get_node_type())
-	{
-	case AstToken::ID:
-		visit(reinterpret_cast<VarNode*>(n));
-		break;
-	case AstToken::ASSIGN:
-		visit(reinterpret_cast<AssignNode*>(n));
-		break;
-	case AstToken::PRINT:
-		visit(reinterpret_cast<PrintNode*>(n));
-		break;
-	case AstToken::PLUS:
-		visit(reinterpret_cast<AddNode*>(n));
-		break;
-	case AstToken::MULT:
-		visit(reinterpret_cast<MultNode*>(n));
-		break;
-	case AstToken::DOT:
-		visit(reinterpret_cast<DotProductNode*>(n));
-		break;
-	case AstToken::INT:
-		visit(reinterpret_cast<IntNode*>(n));
-		break;
-	case AstToken::VEC:
-		visit(reinterpret_cast<VecNode*>(n));
-		break;
-	case AstToken::STAT_LIST:
-		visit(reinterpret_cast<StatListNode*>(n));
-		break;
-	case AstToken::LEFT_SHIFT:
-		visit(reinterpret_cast<LeftShiftNode*>(n));
-		break;
-	default:
-		std::cout << "visit invalid type" << node->get_node_type() << " " << node->to_string() << std::endl;
-	}
+	dispatch(node);
+}
+
+void AstVisitor::visit_unknown(const Ast *node) const
+{
+	out << "visit invalid type" << node->get_node_type() << " " << node->to_string() << '\n';
 }
 
 void AstVisitor::visit(const AssignNode *node) const
 {
-	visit(node->left);
-	std::cout << " " << node->to_string() << " ";
-	visit(node->right);
+	dispatch(node->left);
+	out << " " << node->to_string() << " ";
+	dispatch(node->right);
 }
 
 void AstVisitor::visit(const PrintNode *node) const
 {
-	std::cout << node->to_string() << " ";
-	visit(node->element);
+	out << node->to_string() << " ";
+	dispatch(node->element);
 }
 
 void AstVisitor::visit(const StatListNode *node) const
 {
 	for (auto ele : node->elements)
 	{
-		visit(ele);
-		std::cout << std::endl;
+		dispatch(ele);
+		out << '\n';
 	}
 }
 
 void AstVisitor::visit(const VarNode *node) const
 {
-	std::cout << node->to_string();
+	out << node->to_string();
 }
 
 void AstVisitor::visit(const AddNode *node) const
 {
-	std::cout << "(";
-	visit(node->left);
-	std::cout << " " << node->to_string() << " ";
-	visit(node->right);
-	std::cout << ")";
+	out << "(";
+	dispatch(node->left);
+	out << " " << node->to_string() << " ";
+	dispatch(node->right);
+	out << ")";
 }
 
 void AstVisitor::visit(const DotProductNode *node) const
 {
-	visit(node->left);
-	std::cout << " " << node->to_string() << " ";
-	visit(node->right);
+	dispatch(node->left);
+	out << " " << node->to_string() << " ";
+	dispatch(node->right);
 }
 
 void AstVisitor::visit(const IntNode *node) const
 {
-	std::cout << node->to_string();
+	out << node->value;
 }
 
 void AstVisitor::visit(const MultNode *node) const
 {
-	visit(node->left);
-	std::cout << " " << node->to_string() << " ";
-	visit(node->right);
+	dispatch(node->left);
+	out << " " << node->to_string() << " ";
+	dispatch(node->right);
 }
 
 void AstVisitor::visit(const VecNode *node) const
 {
-	std::cout << " [";
-	std::cout << node->to_string();
+	out << " [";
+	out << node->to_string();
 	for (auto ele : node->elements)
 	{
-		visit(ele);
-		std::cout << ", ";
+		dispatch(ele);
+		out << ", ";
 	}
-	std::cout << "] ";
+	out << "] ";
 }
 
 void AstVisitor::visit(const LeftShiftNode *node) const
 {
-	visit(node->left);
-	std::cout << node->to_string();
-	visit(node->right);
+	dispatch(node->left);
+	out << node->to_string();
+	dispatch(node->right);
 }
@@ -1,7 +1,12 @@
 #ifndef _AST_H
 #define _AST_H
 
+#include "node_pool.h"
+#include "output_sink.h"
+#include "small_vector.h"
+#include <cstdint>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <sstream>
 #include <iostream>
@@ -28,6 +33,9 @@ public:
 	std::string to_string() const;
 	int get_type() const;
 	void set_text(const std::string &str);
+	// storage from NodePool, as for nodes.
+	static void *operator new(size_t size);
+	static void operator delete(void *p, size_t size);
 
 private:
 	int type;
@@ -46,14 +54,51 @@ public:
 	Ast(AstToken *token);
 	Ast(int type);
 	virtual ~Ast();
+	// nodes and tokens take their storage from NodePool.
+	static void *operator new(size_t size);
+	static void operator delete(void *p, size_t size);
+
+	// moves the node's children to out and forgets them, so the node can
+	// be deleted without touching its subtree.
+	virtual void detach_children(std::vector<Ast*> &out);
 
 	int get_node_type() const;
 	virtual std::string to_string() const;
 
 	virtual void visit(AstVisitor *visitor) const;
 
+	// A node starts with one reference, held by whoever created it.
+	// Children are released, not deleted, so a subtree may be shared
+	// by several parents; release() frees a node with its last reference.
+	Ast *retain();
+	static void release(Ast *node);
+	int get_refs() const;
+
+	// Structural hash of the subtree, from the node's label and the hashes
+	// of its children. Constructors compute it; rehash() updates it after
+	// a child was replaced.
+	size_t get_hash() const;
+	void rehash();
+	// structural equality: pointers first, then hashes, then the trees.
+	static bool same(const Ast *a, const Ast *b);
+
+	virtual size_t child_count() const;
+	virtual Ast *child(size_t i) const;
+	// replaces child i without releasing the old one.
+	virtual void set_child(size_t i, Ast *node);
+	// same node type and token, ignoring the children.
+	virtual bool same_label(const Ast *other) const;
+	// a new node with a copy of the token and the same children, each
+	// retained once more; the first step of copying a path.
+	virtual Ast *shallow_copy() const;
+
 protected:
+	void release_children();
+	virtual size_t label_hash() const;
+
 	AstToken *token = nullptr;
+	int refs = 1;
+	size_t hash = 0;
 };
 
 
@@ -62,6 +107,11 @@ class AddNode :public Ast
 public:
 	AddNode(Ast *left, AstToken *add, Ast *right);
 	~AddNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	size_t child_count() const override;
+	Ast *child(size_t i) const override;
+	void set_child(size_t i, Ast *node) override;
+	Ast *shallow_copy() const override;
 
 	Ast *left;
 	Ast *right;
@@ -72,6 +122,11 @@ class AssignNode : public Ast
 public:
 	AssignNode(Ast *left, AstToken *assign, Ast *right);
 	~AssignNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	size_t child_count() const override;
+	Ast *child(size_t i) const override;
+	void set_child(size_t i, Ast *node) override;
+	Ast *shallow_copy() const override;
 
 	Ast *left;
 	Ast *right;
@@ -82,6 +137,11 @@ class DotProductNode : public Ast
 public:
 	DotProductNode(Ast *left, AstToken *dot, Ast *right);
 	~DotProductNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	size_t child_count() const override;
+	Ast *child(size_t i) const override;
+	void set_child(size_t i, Ast *node) override;
+	Ast *shallow_copy() const override;
 
 	Ast *left;
 	Ast *right;
@@ -91,8 +151,21 @@ class IntNode :public Ast
 {
 public:
 	IntNode(AstToken *token);
+	IntNode(int64_t value);
+	std::string to_string() const override;
+	// the value of a run of decimal digits; wraps around like int64_t
+	// arithmetic, so the lexer and this class agree on every literal.
+	static int64_t parse(const char *digits, size_t length);
+	static int64_t parse(const std::string &digits);
 	bool is_zero() const;
-	void set_value(const std::string &value);
+	void set_value(int64_t value);
+	bool same_label(const Ast *other) const override;
+	Ast *shallow_copy() const override;
+
+	int64_t value;
+
+protected:
+	size_t label_hash() const override;
 };
 
 class MultNode : public Ast
@@ -100,6 +173,11 @@ class MultNode : public Ast
 public:
 	MultNode(Ast *left, AstToken *mult, Ast *right);
 	~MultNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	size_t child_count() const override;
+	Ast *child(size_t i) const override;
+	void set_child(size_t i, Ast *node) override;
+	Ast *shallow_copy() const override;
 
 	Ast *left;
 	Ast *right;
@@ -110,6 +188,11 @@ class PrintNode : public Ast
 public:
 	PrintNode(AstToken *pr, Ast *element);
 	~PrintNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	size_t child_count() const override;
+	Ast *child(size_t i) const override;
+	void set_child(size_t i, Ast *node) override;
+	Ast *shallow_copy() const override;
 
 	Ast *element;
 };
@@ -120,14 +203,20 @@ public:
 	StatListNode(const std::vector<Ast*> &elements);
 	StatListNode(const std::initializer_list<Ast*> &elements);
 	~StatListNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	size_t child_count() const override;
+	Ast *child(size_t i) const override;
+	void set_child(size_t i, Ast *node) override;
+	Ast *shallow_copy() const override;
 
-	std::vector<Ast*> elements;
+	SmallVector<Ast*, 4> elements;
 };
 
 class VarNode : public Ast
 {
 public:
 	VarNode(AstToken *var);
+	Ast *shallow_copy() const override;
 };
 
 
@@ -135,11 +224,20 @@ class VecNode : public Ast
 {
 public:
 	VecNode() = delete;
+	// up to four elements are stored in the node.
+	typedef SmallVector<Ast*, 4> Elements;
+
 	VecNode(AstToken *token, std::vector<Ast*> &&elements);
+	VecNode(AstToken *token, Elements &&elements);
 	VecNode(AstToken *token, const std::initializer_list<Ast*> &elements);
 	~VecNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	size_t child_count() const override;
+	Ast *child(size_t i) const override;
+	void set_child(size_t i, Ast *node) override;
+	Ast *shallow_copy() const override;
 
-	std::vector<Ast*> elements;
+	Elements elements;
 
 };
 
@@ -150,16 +248,105 @@ public:
 	LeftShiftNode(const LeftShiftNode&) = delete;
 	LeftShiftNode(Ast *left, AstToken *shift, Ast *right);
 	~LeftShiftNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	size_t child_count() const override;
+	Ast *child(size_t i) const override;
+	void set_child(size_t i, Ast *node) override;
+	Ast *shallow_copy() const override;
 
 	Ast *left;
 	Ast *right;
 };
 
-class AstVisitor
+// Dispatch on the node class without virtual calls or reinterpret_cast.
+// Derived has a visit() overload for each node class; dispatch() looks at
+// the token type once, static_casts the node to its class and calls the
+// overload directly, so the compiler checks every cast and can inline the
+// bodies:
+//
+//   class IntCounter : public StaticVisitor<IntCounter, int>
+//   {
+//   public:
+//       int visit(const IntNode *node) const { return 1; }
+//       template<class Node> int visit(const Node *node) const { return 0; }
+//   };
+//
+// A const node is passed on as const. Nodes of an unknown type go to
+// visit_unknown(), which Derived may declare as well.
+template<class Derived, class R = void>
+class StaticVisitor
 {
 public:
-	AstVisitor() = default;
+	R dispatch(Ast *node)
+	{
+		return dispatch(static_cast<Derived&>(*this), node);
+	}
+
+	R dispatch(const Ast *node)
+	{
+		return dispatch(static_cast<Derived&>(*this), node);
+	}
+
+	R dispatch(Ast *node) const
+	{
+		return dispatch(static_cast<const Derived&>(*this), node);
+	}
+
+	R dispatch(const Ast *node) const
+	{
+		return dispatch(static_cast<const Derived&>(*this), node);
+	}
+
+	R visit_unknown(const Ast *node) const
+	{
+		return R();
+	}
+
+private:
+	// T with the constness of Node.
+	template<class T, class Node>
+	using Like = typename std::conditional<std::is_const<Node>::value, const T, T>::type;
+
+	template<class Self, class Node>
+	static R dispatch(Self &self, Node *node)
+	{
+		switch (node->get_node_type())
+		{
+		case AstToken::ID:
+			return self.visit(static_cast<Like<VarNode, Node>*>(node));
+		case AstToken::ASSIGN:
+			return self.visit(static_cast<Like<AssignNode, Node>*>(node));
+		case AstToken::PRINT:
+			return self.visit(static_cast<Like<PrintNode, Node>*>(node));
+		case AstToken::PLUS:
+			return self.visit(static_cast<Like<AddNode, Node>*>(node));
+		case AstToken::MULT:
+			return self.visit(static_cast<Like<MultNode, Node>*>(node));
+		case AstToken::DOT:
+			return self.visit(static_cast<Like<DotProductNode, Node>*>(node));
+		case AstToken::INT:
+			return self.visit(static_cast<Like<IntNode, Node>*>(node));
+		case AstToken::VEC:
+			return self.visit(static_cast<Like<VecNode, Node>*>(node));
+		case AstToken::STAT_LIST:
+			return self.visit(static_cast<Like<StatListNode, Node>*>(node));
+		case AstToken::LEFT_SHIFT:
+			return self.visit(static_cast<Like<LeftShiftNode, Node>*>(node));
+		default:
+			return self.visit_unknown(node);
+		}
+	}
+};
+
+// Prints the nodes through an OutputSink. The text is buffered until
+// flush(); Ast::visit(), the entry point, flushes when it returns.
+class AstVisitor : public StaticVisitor<AstVisitor>
+{
+public:
+	AstVisitor(std::ostream &out = std::cout);
+	void flush() const;
 	void visit(const Ast *node) const;
+	void visit_unknown(const Ast *node) const;
 	void visit(const AssignNode *node) const;
 	void visit(const PrintNode *node) const;
 	void visit(const StatListNode *node) const;
@@ -170,6 +357,9 @@ public:
 	void visit(const MultNode *node) const;
 	void visit(const VecNode *node) const;
 	void visit(const LeftShiftNode *node) const;
+
+private:
+	mutable OutputSink out;
 };
 
 #endif // !_AST_H
@@ -1,14 +1,12 @@
 #include "ast.h"
 #include "rule.h"
+#include "parser.h"
+#include "node_factory.h"
 
 
 IntNode* get_int_node(int i)
 {
-	std::stringstream ss;
-	ss << i;
-
-	auto node = new IntNode(new AstToken(AstToken::INT, ss.str()));
-	return node;
+	return new IntNode(i);
 }
 
 int main()
@@ -87,6 +85,64 @@ int main()
 	stat2->visit(visitor);
 	std::cout << std::endl;
 
+	// rules applied to a parsed program
+	std::cout << "--------------------------------" << std::endl;
+	auto lexer = Lexer("4 * [1, 5 * 0, 0 * 3]; 2 * (x + x); y * 3 + y * 3");
+	auto parser = Parser(lexer);
+	Ast *program = parser.program();
+	if (program != nullptr)
+	{
+		rewriter.rewrite(program);
+		program->visit(visitor);
+	}
+
+	// a persistent rewrite leaves the parsed tree as it was
+	auto before_lexer = Lexer("x = 2 * y; print 3 * [1, 2]");
+	auto before_parser = Parser(before_lexer);
+	Ast *before = before_parser.program();
+	if (before != nullptr)
+	{
+		auto after = rewriter.rewrite_persistent(before);
+		after->visit(visitor);
+		before->visit(visitor);
+		Ast::release(after);
+		delete before;
+	}
+
+	// structurally equal subtrees are one node in a NodeFactory
+	NodeFactory factory;
+	auto lhs = factory.make_mult(factory.make_var("y"), factory.make_int(3));
+	auto rhs = factory.make_mult(factory.make_var("y"), factory.make_int(3));
+	std::cout << (lhs == rhs ? "shared" : "not shared") << ", " << factory.size() << " nodes" << std::endl;
+	Ast::release(lhs);
+	Ast::release(rhs);
+
+	// literals folded, with the other rules run after folding
+	std::cout << "--------------------------------" << std::endl;
+	std::cout << "constant folding:" << std::endl;
+	auto fold_rule = new ConstantFoldRule(Rule::BOTTOMUP);
+	auto folder = AstRewriter();
+	folder.add_rule(new ScalarVecMultRule(Rule::TOPDOWN));
+	folder.add_rule(fold_rule);
+	folder.add_rule(new XPlusXRule(Rule::BOTTOMUP));
+	folder.add_rule(new MultByTwoRule(Rule::BOTTOMUP));
+	folder.add_rule(new CombineLeftShiftRule(Rule::BOTTOMUP));
+	auto fold_lexer = Lexer("x = 1 + 4; print 2 * [3, 4] + [1, 1]; print [1, 2] . [3, 4] << 1 << 2; print 2 * (2 * x)");
+	auto fold_parser = Parser(fold_lexer);
+	Ast *folded = fold_parser.program();
+	if (folded != nullptr)
+	{
+		folder.rewrite(folded);
+		folded->visit(visitor);
+		std::cout << fold_rule->get_removed() << " nodes removed" << std::endl;
+	}
+
+	delete folded;
+	delete program;
+	delete stat1;
+	delete stat2;
+	delete stats_list;
+	delete visitor;
 	return 0;
 
 }
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "node_factory.h"
+
+NodeFactory::~NodeFactory()
+{
+	for (auto entry : table)
+		Ast::release(entry.second);
+}
+
+IntNode *NodeFactory::make_int(int64_t value)
+{
+	return static_cast<IntNode*>(intern(new IntNode(value)));
+}
+
+VarNode *NodeFactory::make_var(const std::string &name)
+{
+	return static_cast<VarNode*>(intern(new VarNode(new AstToken(AstToken::ID, name))));
+}
+
+Ast *NodeFactory::make_add(Ast *left, Ast *right)
+{
+	return intern(new AddNode(left, new AstToken(AstToken::PLUS, "+"), right));
+}
+
+Ast *NodeFactory::make_mult(Ast *left, Ast *right)
+{
+	return intern(new MultNode(left, new AstToken(AstToken::MULT, "*"), right));
+}
+
+Ast *NodeFactory::make_dot(Ast *left, Ast *right)
+{
+	return intern(new DotProductNode(left, new AstToken(AstToken::DOT, "."), right));
+}
+
+Ast *NodeFactory::make_left_shift(Ast *left, Ast *right)
+{
+	return intern(new LeftShiftNode(left, new AstToken(AstToken::LEFT_SHIFT, " << "), right));
+}
+
+Ast *NodeFactory::make_assign(Ast *left, Ast *right)
+{
+	return intern(new AssignNode(left, new AstToken(AstToken::ASSIGN, "="), right));
+}
+
+Ast *NodeFactory::make_print(Ast *element)
+{
+	return intern(new PrintNode(new AstToken(AstToken::PRINT, "print"), element));
+}
+
+Ast *NodeFactory::make_vec(std::vector<Ast*> &&elements)
+{
+	return intern(new VecNode(new AstToken(AstToken::VEC), std::move(elements)));
+}
+
+// Children are already unique, so two nodes are equal exactly when their
+// labels match and they point to the same children.
+Ast *NodeFactory::intern(Ast *node)
+{
+	auto range = table.equal_range(node->get_hash());
+	for (auto iter = range.first; iter != range.second; ++iter)
+	{
+		auto candidate = iter->second;
+		if (!candidate->same_label(node) || candidate->child_count() != node->child_count())
+			continue;
+		size_t i = 0;
+		while (i < node->child_count() && candidate->child(i) == node->child(i))
+			++i;
+		if (i == node->child_count())
+		{
+			candidate->retain();
+			Ast::release(node);
+			return candidate;
+		}
+	}
+	table.insert(std::make_pair(node->get_hash(), node->retain()));
+	return node;
+}
+
+Ast *NodeFactory::intern_tree(Ast *tree)
+{
+	for (size_t i = 0; i < tree->child_count(); ++i)
+	{
+		auto child = tree->child(i);
+		if (child == nullptr)
+			continue;
+		// the child's reference moves from tree to intern_tree and back.
+		tree->set_child(i, intern_tree(child));
+	}
+	return intern(tree);
+}
+
+size_t NodeFactory::size() const
+{
+	return table.size();
+}
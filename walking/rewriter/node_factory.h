@@ -0,0 +1,50 @@
+#ifndef _NODE_FACTORY_H
+#define _NODE_FACTORY_H
+
+#include "ast.h"
+#include <unordered_map>
+
+// Hash-conses rewriter trees: structurally equal subtrees built through
+// one factory are the same node, so Ast::same() stops at the pointer
+// check and repeated code is stored once.
+//
+//   NodeFactory factory;
+//   auto sum = factory.make_add(factory.make_var("x"), factory.make_var("x"));
+//   // both children of sum are one VarNode
+//
+// make_*() and intern() take over the references passed in and return a
+// new reference, dropped with Ast::release(). The factory keeps a
+// reference of its own to every node it returned until it is destroyed.
+// Shared nodes must not be modified.
+class NodeFactory
+{
+public:
+	NodeFactory() = default;
+	~NodeFactory();
+	NodeFactory(const NodeFactory&) = delete;
+	NodeFactory &operator=(const NodeFactory&) = delete;
+
+	IntNode *make_int(int64_t value);
+	VarNode *make_var(const std::string &name);
+	Ast *make_add(Ast *left, Ast *right);
+	Ast *make_mult(Ast *left, Ast *right);
+	Ast *make_dot(Ast *left, Ast *right);
+	Ast *make_left_shift(Ast *left, Ast *right);
+	Ast *make_assign(Ast *left, Ast *right);
+	Ast *make_print(Ast *element);
+	Ast *make_vec(std::vector<Ast*> &&elements);
+
+	// the factory's node equal to node; node's children must already be
+	// the factory's.
+	Ast *intern(Ast *node);
+	// interns every subtree of tree, children first.
+	Ast *intern_tree(Ast *tree);
+
+	// distinct nodes held.
+	size_t size() const;
+
+private:
+	std::unordered_multimap<size_t, Ast*> table;
+};
+
+#endif // !_NODE_FACTORY_H
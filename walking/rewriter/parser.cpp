@@ -0,0 +1,375 @@
+#include "parser.h"
+
+Token::Token(int type, unsigned start, unsigned length)
+	: type(type), start(start), length(length)
+{}
+
+int Token::get_type() const
+{
+	return type;
+}
+
+unsigned Token::get_start() const
+{
+	return start;
+}
+
+unsigned Token::get_length() const
+{
+	return length;
+}
+
+
+const char Lexer::LEOF;
+const int Lexer::EOF_TYPE;
+const int Lexer::NAME;
+const int Lexer::INT;
+const int Lexer::PLUS;
+const int Lexer::MULT;
+const int Lexer::DOT;
+const int Lexer::ASSIGN;
+const int Lexer::LBRACK;
+const int Lexer::RBRACK;
+const int Lexer::LPAREN;
+const int Lexer::RPAREN;
+const int Lexer::COMMA;
+const int Lexer::SEMICOLON;
+const int Lexer::PRINT;
+const int Lexer::LEFT_SHIFT;
+const std::vector<std::string> Lexer::token_names = { "n/a", "<EOF>", "NAME", "INT", "PLUS", "MULT", "DOT",
+	"ASSIGN", "LBRACK", "RBRACK", "LPAREN", "RPAREN", "COMMA", "SEMICOLON", "PRINT", "LEFT_SHIFT" };
+
+Lexer::Lexer(const std::string &input)
+	: input(input), p(0)
+{
+	c = input.empty() ? LEOF : input[p];
+}
+
+const std::string &Lexer::get_token_name(int type)
+{
+	if (type < 0 || type >= (int)token_names.size())
+		return token_names[0];
+	return token_names[type];
+}
+
+std::string Lexer::text(const Token &token) const
+{
+	return input.substr(token.get_start(), token.get_length());
+}
+
+int64_t Lexer::int_value(const Token &token) const
+{
+	return IntNode::parse(input.data() + token.get_start(), token.get_length());
+}
+
+void Lexer::consume()
+{
+	++p;
+	if (p < input.size())
+		c = input[p];
+	else
+		c = LEOF;
+}
+
+bool Lexer::is_letter() const
+{
+	return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z');
+}
+
+bool Lexer::is_digit() const
+{
+	return '0' <= c && c <= '9';
+}
+
+void Lexer::WS()
+{
+	while (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+		consume();
+}
+
+Token Lexer::name()
+{
+	auto start = p;
+	do {
+		consume();
+	} while (is_letter() || is_digit());
+
+	auto length = p - start;
+	if (input.compare(start, length, "print") == 0)
+		return Token(PRINT, start, length);
+	return Token(NAME, start, length);
+}
+
+Token Lexer::number()
+{
+	auto start = p;
+	do {
+		consume();
+	} while (is_digit());
+	return Token(INT, start, p - start);
+}
+
+Token Lexer::next_token()
+{
+	while (c != LEOF)
+	{
+		auto start = p;
+		switch (c)
+		{
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+			WS();
+			continue;
+		case '+':
+			consume();
+			return Token(PLUS, start, 1);
+		case '*':
+			consume();
+			return Token(MULT, start, 1);
+		case '.':
+			consume();
+			return Token(DOT, start, 1);
+		case '=':
+			consume();
+			return Token(ASSIGN, start, 1);
+		case '[':
+			consume();
+			return Token(LBRACK, start, 1);
+		case ']':
+			consume();
+			return Token(RBRACK, start, 1);
+		case '(':
+			consume();
+			return Token(LPAREN, start, 1);
+		case ')':
+			consume();
+			return Token(RPAREN, start, 1);
+		case ',':
+			consume();
+			return Token(COMMA, start, 1);
+		case ';':
+			consume();
+			return Token(SEMICOLON, start, 1);
+		case '<':
+			consume();
+			if (c == '<')
+			{
+				consume();
+				return Token(LEFT_SHIFT, start, 2);
+			}
+			std::cout << "invalid character: <" << std::endl;
+			continue;
+		default:
+			if (is_letter())
+				return name();
+			if (is_digit())
+				return number();
+			std::cout << "invalid character: " << c << std::endl;
+			consume();
+		}
+	}
+	return Token(EOF_TYPE, p, 0);
+}
+
+
+Parser::Parser(Lexer &input)
+	: input(input)
+{
+	consume();
+}
+
+bool Parser::has_error() const
+{
+	return error;
+}
+
+void Parser::consume()
+{
+	lookahead = input.next_token();
+}
+
+bool Parser::match(int type)
+{
+	if (lookahead.get_type() != type)
+		return false;
+	consume();
+	return true;
+}
+
+Ast *Parser::error_at(const char *expecting)
+{
+	if (!error)
+	{
+		std::cout << "parse error: expecting " << expecting << ", found "
+			<< Lexer::get_token_name(lookahead.get_type()) << " '" << input.text(lookahead) << "'" << std::endl;
+	}
+	error = true;
+	return nullptr;
+}
+
+int Parser::precedence(int type)
+{
+	switch (type)
+	{
+	case Lexer::LEFT_SHIFT:
+		return 1;
+	case Lexer::PLUS:
+		return 2;
+	case Lexer::MULT:
+	case Lexer::DOT:
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+StatListNode *Parser::program()
+{
+	std::vector<Ast*> stats;
+	while (lookahead.get_type() != Lexer::EOF_TYPE)
+	{
+		if (match(Lexer::SEMICOLON))
+			continue;
+		auto stat = statement();
+		if (stat == nullptr)
+			break;
+		stats.push_back(stat);
+		if (lookahead.get_type() != Lexer::EOF_TYPE && !match(Lexer::SEMICOLON))
+		{
+			error_at("';'");
+			break;
+		}
+	}
+	if (error)
+	{
+		for (auto stat : stats)
+			delete stat;
+		return nullptr;
+	}
+	return new StatListNode(stats);
+}
+
+Ast *Parser::statement()
+{
+	if (lookahead.get_type() == Lexer::PRINT)
+	{
+		consume();
+		auto element = expr();
+		if (element == nullptr)
+			return nullptr;
+		return new PrintNode(new AstToken(AstToken::PRINT, "print"), element);
+	}
+	if (lookahead.get_type() == Lexer::NAME)
+	{
+		auto left = primary();
+		if (!match(Lexer::ASSIGN))
+			return expr_tail(left, 1);
+		auto right = expr();
+		if (right == nullptr)
+		{
+			delete left;
+			return nullptr;
+		}
+		return new AssignNode(left, new AstToken(AstToken::ASSIGN, "="), right);
+	}
+	return expr();
+}
+
+Ast *Parser::expr(int min_prec)
+{
+	auto left = primary();
+	if (left == nullptr)
+		return nullptr;
+	return expr_tail(left, min_prec);
+}
+
+Ast *Parser::expr_tail(Ast *left, int min_prec)
+{
+	auto prec = precedence(lookahead.get_type());
+	while (prec >= min_prec && prec > 0)
+	{
+		auto op = lookahead.get_type();
+		consume();
+		// operators are left associative, so the right operand only
+		// takes operators that bind tighter than this one.
+		auto right = expr(prec + 1);
+		if (right == nullptr)
+		{
+			delete left;
+			return nullptr;
+		}
+		left = make_binary(op, left, right);
+		prec = precedence(lookahead.get_type());
+	}
+	return left;
+}
+
+Ast *Parser::make_binary(int op, Ast *left, Ast *right)
+{
+	switch (op)
+	{
+	case Lexer::PLUS:
+		return new AddNode(left, new AstToken(AstToken::PLUS, "+"), right);
+	case Lexer::MULT:
+		return new MultNode(left, new AstToken(AstToken::MULT, "*"), right);
+	case Lexer::LEFT_SHIFT:
+		return new LeftShiftNode(left, new AstToken(AstToken::LEFT_SHIFT, " << "), right);
+	default:
+		return new DotProductNode(left, new AstToken(AstToken::DOT, "."), right);
+	}
+}
+
+Ast *Parser::primary()
+{
+	auto token = lookahead;
+	switch (token.get_type())
+	{
+	case Lexer::INT:
+		consume();
+		return new IntNode(input.int_value(token));
+	case Lexer::NAME:
+		consume();
+		return new VarNode(new AstToken(AstToken::ID, input.text(token)));
+	case Lexer::LBRACK:
+		return vec_literal();
+	case Lexer::LPAREN:
+	{
+		consume();
+		auto node = expr();
+		if (node == nullptr)
+			return nullptr;
+		if (!match(Lexer::RPAREN))
+		{
+			delete node;
+			return error_at("')'");
+		}
+		return node;
+	}
+	default:
+		return error_at("expression");
+	}
+}
+
+Ast *Parser::vec_literal()
+{
+	consume();
+	VecNode::Elements elements;
+	do {
+		auto element = expr();
+		if (element == nullptr)
+			break;
+		elements.push_back(element);
+	} while (match(Lexer::COMMA));
+
+	if (!error && !match(Lexer::RBRACK))
+		error_at("']'");
+	if (error)
+	{
+		for (auto element : elements)
+			delete element;
+		return nullptr;
+	}
+	return new VecNode(new AstToken(AstToken::VEC), std::move(elements));
+}
@@ -0,0 +1,104 @@
+#ifndef _PARSER_H
+#define _PARSER_H
+
+#include <string>
+#include <vector>
+#include "ast.h"
+
+
+class Token
+{
+public:
+	Token() = default;
+	Token(int type, unsigned start, unsigned length);
+	int get_type() const;
+	unsigned get_start() const;
+	unsigned get_length() const;
+
+private:
+	int type = 0;
+	unsigned start = 0;
+	unsigned length = 0;
+};
+
+
+// Tokens only record their position in the input, text is copied out
+// when a node actually needs it (names); INT literals are converted
+// straight to their value.
+class Lexer
+{
+public:
+	Lexer(const std::string &input);
+	Token next_token();
+	std::string text(const Token &token) const;
+	// value of an INT token; wraps around like int64_t arithmetic.
+	int64_t int_value(const Token &token) const;
+	static const std::string &get_token_name(int type);
+
+	static const char LEOF = (char)-1;
+
+	static const int EOF_TYPE = 1;
+	static const int NAME = 2;
+	static const int INT = 3;
+	static const int PLUS = 4;
+	static const int MULT = 5;
+	static const int DOT = 6;
+	static const int ASSIGN = 7;
+	static const int LBRACK = 8;
+	static const int RBRACK = 9;
+	static const int LPAREN = 10;
+	static const int RPAREN = 11;
+	static const int COMMA = 12;
+	static const int SEMICOLON = 13;
+	static const int PRINT = 14;
+	static const int LEFT_SHIFT = 15;
+	static const std::vector<std::string> token_names;
+
+private:
+	void consume();
+	bool is_letter() const;
+	bool is_digit() const;
+	void WS();
+	Token name();
+	Token number();
+
+	std::string input;
+	unsigned p;
+	char c;
+};
+
+
+// Precedence climbing parser for the vector math language:
+//
+//   program : stat (';' stat)* ';'? EOF
+//   stat    : 'print' expr | ID '=' expr | expr
+//   expr    : primary (op expr)*        op: '<<' < '+' < '*' = '.'
+//   primary : INT | ID | '[' expr (',' expr)* ']' | '(' expr ')'
+//
+// Nodes are built while parsing, one token of lookahead, no backtracking.
+class Parser
+{
+public:
+	Parser(Lexer &input);
+
+	StatListNode *program();
+	Ast *statement();
+	Ast *expr(int min_prec = 1);
+	Ast *primary();
+	bool has_error() const;
+
+private:
+	Ast *expr_tail(Ast *left, int min_prec);
+	Ast *vec_literal();
+	Ast *make_binary(int op, Ast *left, Ast *right);
+	static int precedence(int type);
+	bool match(int type);
+	void consume();
+	Ast *error_at(const char *expecting);
+
+	Lexer &input;
+	Token lookahead;
+	bool error = false;
+};
+
+#endif // !_PARSER_H
@@ -0,0 +1,55 @@
+#include "reclaimer.h"
+
+AstReclaimer::AstReclaimer()
+	: worker(&AstReclaimer::run, this)
+{}
+
+AstReclaimer::~AstReclaimer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+void AstReclaimer::reclaim(Ast *tree)
+{
+	if (tree == nullptr)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(tree);
+	}
+	wake.notify_one();
+}
+
+void AstReclaimer::drain()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this]() { return queue.empty() && !busy; });
+}
+
+void AstReclaimer::run()
+{
+	std::vector<Ast*> batch;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this]() { return stop || !queue.empty(); });
+		if (queue.empty())
+			break;
+		// take the whole queue, so the lock is not held while freeing.
+		batch.swap(queue);
+		busy = true;
+		lock.unlock();
+		for (auto tree : batch)
+			delete tree;
+		batch.clear();
+		lock.lock();
+		busy = false;
+		if (queue.empty())
+			idle.notify_all();
+	}
+}
@@ -12,7 +12,7 @@ Rule::~Rule()
 
 Ast* Rule::rewrite(Ast *node)
 {
-	return node;
+	return node->retain();
 }
 
 bool Rule::match(const Ast *node) const
@@ -42,15 +42,14 @@ Ast* ScalarVecMultRule::rewrite(Ast *node)
 	auto left = reinterpret_cast<IntNode*>(n->left);
 	auto right = reinterpret_cast<VecNode*>(n->right);
 
-	std::vector<Ast*> elements;
+	VecNode::Elements elements;
 	for (auto n_right : right->elements)
 	{
-		auto n_left = new IntNode(new AstToken(AstToken::INT, left->to_string()));
-		auto ele = new MultNode(n_left, new AstToken(AstToken::MULT, "*"), n_right);
+		auto n_left = new IntNode(left->value);
+		auto ele = new MultNode(n_left, new AstToken(AstToken::MULT, "*"), n_right->retain());
 		elements.push_back(ele);
 	}
 	auto root = new VecNode(new AstToken(AstToken::VEC), std::move(elements));
-	right->elements.clear();
 	return root;
 }
 
@@ -62,16 +61,13 @@ bool MultZeroRule::match(const Ast *node) const
 	if (node->get_node_type() != AstToken::MULT)
 		return false;
 	auto n = reinterpret_cast<MultNode*>(const_cast<Ast*>(node));
-	return n->right->get_node_type() == AstToken::INT && n->right->to_string() == "0";
+	return n->right->get_node_type() == AstToken::INT && reinterpret_cast<IntNode*>(n->right)->is_zero();
 }
 
 Ast* MultZeroRule::rewrite(Ast *node)
 {
 	auto n = reinterpret_cast<MultNode*>(node);
-	auto right = n->right;
-
-	n->right = nullptr;
-	return right;
+	return n->right->retain();
 }
 
 ZeroMultRule::ZeroMultRule(Rule::VISIT_ORDER order)
@@ -82,16 +78,13 @@ bool ZeroMultRule::match(const Ast *node) const
 	if (node->get_node_type() != AstToken::MULT)
 		return false;
 	auto n = reinterpret_cast<MultNode*>(const_cast<Ast*>(node));
-	return n->left->get_node_type() == AstToken::INT && n->left->to_string() == "0";
+	return n->left->get_node_type() == AstToken::INT && reinterpret_cast<IntNode*>(n->left)->is_zero();
 }
 
 Ast* ZeroMultRule::rewrite(Ast *node)
 {
 	auto n = reinterpret_cast<MultNode*>(node);
-	auto left = n->left;
-
-	n->left = nullptr;
-	return left;
+	return n->left->retain();
 }
 
 XPlusXRule::XPlusXRule(Rule::VISIT_ORDER order)
@@ -102,19 +95,13 @@ bool XPlusXRule::match(const Ast *node) const
 	if (node->get_node_type() != AstToken::PLUS)
 		return false;
 	auto n = reinterpret_cast<AddNode*>(const_cast<Ast*>(node));
-	return n->left->get_node_type() == AstToken::ID && n->right->get_node_type() == AstToken::ID &&
-		n->left->to_string() == n->right->to_string();
+	return Ast::same(n->left, n->right);
 }
 
 Ast* XPlusXRule::rewrite(Ast *node)
 {
 	auto n = reinterpret_cast<AddNode*>(node);
-	auto v = n->left->to_string();
-	
-	auto left = n->left;
-	n->left = nullptr;
-
-	auto root = new MultNode(new IntNode(new AstToken(AstToken::INT, "2")), new AstToken(AstToken::MULT, "*"), left);
+	auto root = new MultNode(new IntNode(2), new AstToken(AstToken::MULT, "*"), n->left->retain());
 	return root;
 }
 
@@ -126,15 +113,13 @@ bool MultByTwoRule::match(const Ast *node) const
 	if (node->get_node_type() != AstToken::MULT)
 		return false;
 	auto n = reinterpret_cast<MultNode*>(const_cast<Ast*>(node));
-	return n->left->get_node_type() == AstToken::INT && n->left->to_string() == "2";
+	return n->left->get_node_type() == AstToken::INT && reinterpret_cast<IntNode*>(n->left)->value == 2;
 }
 
 Ast* MultByTwoRule::rewrite(Ast *node)
 {
 	auto n = reinterpret_cast<MultNode*>(node);
-	auto right = n->right;
-	n->right = nullptr;
-	auto root = new LeftShiftNode(right, new AstToken(AstToken::LEFT_SHIFT, " << "), new IntNode(new AstToken(AstToken::INT, "1")));
+	auto root = new LeftShiftNode(n->right->retain(), new AstToken(AstToken::LEFT_SHIFT, " << "), new IntNode(1));
 	return root;
 }
 
@@ -158,16 +143,192 @@ Ast* CombineLeftShiftRule::rewrite(Ast *node)
 {
 	auto n = reinterpret_cast<LeftShiftNode*>(node);
 	auto left = reinterpret_cast<LeftShiftNode*>(n->left);
-	n->left = nullptr;
-	IntNode *right = reinterpret_cast<IntNode*>(left->right);
-	auto v1 = atoi(right->to_string().c_str());
-	auto v2 = atoi(n->right->to_string().c_str());
-	auto s = v1 + v2;
-	std::stringstream ss;
-	ss << s;
-	std::string text = ss.str();
-	right->set_value(text);
-	return left;
+	auto shift = reinterpret_cast<IntNode*>(left->right)->value + reinterpret_cast<IntNode*>(n->right)->value;
+	return new LeftShiftNode(left->left->retain(), new AstToken(AstToken::LEFT_SHIFT, " << "), new IntNode(shift));
+}
+
+namespace
+{
+	int64_t wrap_add(int64_t a, int64_t b)
+	{
+		return (int64_t)((uint64_t)a + (uint64_t)b);
+	}
+
+	int64_t wrap_mult(int64_t a, int64_t b)
+	{
+		return (int64_t)((uint64_t)a * (uint64_t)b);
+	}
+
+	bool is_int(const Ast *node)
+	{
+		return node->get_node_type() == AstToken::INT;
+	}
+
+	// a vector of int literals.
+	bool is_vec(const Ast *node)
+	{
+		if (node->get_node_type() != AstToken::VEC)
+			return false;
+		for (auto ele : static_cast<const VecNode*>(node)->elements)
+		{
+			if (!is_int(ele))
+				return false;
+		}
+		return true;
+	}
+
+	int64_t int_value(const Ast *node)
+	{
+		return static_cast<const IntNode*>(node)->value;
+	}
+
+	const VecNode::Elements &vec_elements(const Ast *node)
+	{
+		return static_cast<const VecNode*>(node)->elements;
+	}
+
+	bool same_length(const Ast *left, const Ast *right)
+	{
+		return vec_elements(left).size() == vec_elements(right).size();
+	}
+
+	// nodes in a literal.
+	size_t literal_size(const Ast *node)
+	{
+		return is_int(node) ? 1 : 1 + vec_elements(node).size();
+	}
+
+	// applies f to the elements of one literal vector, or to the pairs of
+	// elements of two.
+	template<class F>
+	Ast *map_vec(const Ast *vec, F f)
+	{
+		VecNode::Elements elements;
+		for (auto ele : vec_elements(vec))
+			elements.push_back(new IntNode(f(int_value(ele))));
+		return new VecNode(new AstToken(AstToken::VEC), std::move(elements));
+	}
+
+	template<class F>
+	Ast *zip_vec(const Ast *left, const Ast *right, F f)
+	{
+		VecNode::Elements elements;
+		auto &l = vec_elements(left);
+		auto &r = vec_elements(right);
+		for (size_t i = 0; i < l.size(); ++i)
+			elements.push_back(new IntNode(f(int_value(l[i]), int_value(r[i]))));
+		return new VecNode(new AstToken(AstToken::VEC), std::move(elements));
+	}
+
+	Ast *left_of(const Ast *node)
+	{
+		switch (node->get_node_type())
+		{
+		case AstToken::PLUS:
+			return static_cast<const AddNode*>(node)->left;
+		case AstToken::MULT:
+			return static_cast<const MultNode*>(node)->left;
+		case AstToken::DOT:
+			return static_cast<const DotProductNode*>(node)->left;
+		default:
+			return static_cast<const LeftShiftNode*>(node)->left;
+		}
+	}
+
+	Ast *right_of(const Ast *node)
+	{
+		switch (node->get_node_type())
+		{
+		case AstToken::PLUS:
+			return static_cast<const AddNode*>(node)->right;
+		case AstToken::MULT:
+			return static_cast<const MultNode*>(node)->right;
+		case AstToken::DOT:
+			return static_cast<const DotProductNode*>(node)->right;
+		default:
+			return static_cast<const LeftShiftNode*>(node)->right;
+		}
+	}
+}
+
+ConstantFoldRule::ConstantFoldRule(Rule::VISIT_ORDER order)
+	:Rule(order) {}
+
+bool ConstantFoldRule::match(const Ast *node) const
+{
+	auto type = node->get_node_type();
+	if (type != AstToken::PLUS && type != AstToken::MULT && type != AstToken::DOT && type != AstToken::LEFT_SHIFT)
+		return false;
+	auto left = left_of(node);
+	auto right = right_of(node);
+	switch (type)
+	{
+	case AstToken::PLUS:
+		return (is_int(left) && is_int(right)) || (is_vec(left) && is_vec(right) && same_length(left, right));
+	case AstToken::MULT:
+		return (is_int(left) && (is_int(right) || is_vec(right)))
+			|| (is_vec(left) && is_int(right))
+			|| (is_vec(left) && is_vec(right) && same_length(left, right));
+	case AstToken::DOT:
+		return is_vec(left) && is_vec(right) && same_length(left, right);
+	default:
+		return (is_int(left) || is_vec(left)) && is_int(right)
+			&& int_value(right) >= 0 && int_value(right) < 64;
+	}
+}
+
+Ast* ConstantFoldRule::rewrite(Ast *node)
+{
+	auto left = left_of(node);
+	auto right = right_of(node);
+	Ast *root;
+	switch (node->get_node_type())
+	{
+	case AstToken::PLUS:
+		if (is_int(left))
+			root = new IntNode(wrap_add(int_value(left), int_value(right)));
+		else
+			root = zip_vec(left, right, wrap_add);
+		break;
+	case AstToken::MULT:
+		if (is_int(left) && is_int(right))
+			root = new IntNode(wrap_mult(int_value(left), int_value(right)));
+		else if (is_int(left) || is_int(right))
+		{
+			auto k = is_int(left) ? int_value(left) : int_value(right);
+			root = map_vec(is_int(left) ? right : left, [k](int64_t v) { return wrap_mult(k, v); });
+		}
+		else
+			root = zip_vec(left, right, wrap_mult);
+		break;
+	case AstToken::DOT:
+	{
+		int64_t sum = 0;
+		auto &l = vec_elements(left);
+		auto &r = vec_elements(right);
+		for (size_t i = 0; i < l.size(); ++i)
+			sum = wrap_add(sum, wrap_mult(int_value(l[i]), int_value(r[i])));
+		root = new IntNode(sum);
+		break;
+	}
+	default:
+	{
+		auto shift = int_value(right);
+		auto shifted = [shift](int64_t v) { return (int64_t)((uint64_t)v << shift); };
+		if (is_int(left))
+			root = new IntNode(shifted(int_value(left)));
+		else
+			root = map_vec(left, shifted);
+		break;
+	}
+	}
+	removed += 1 + literal_size(left) + literal_size(right) - literal_size(root);
+	return root;
+}
+
+size_t ConstantFoldRule::get_removed() const
+{
+	return removed;
 }
 
 AstRewriter::~AstRewriter()
@@ -202,14 +363,66 @@ void AstRewriter::rewrite(Ast *&node)
 		if (rule->match(node))
 		{
 			new_node = rule->rewrite(node);
-			delete node;
+			Ast::release(node);
 			node = new_node;
 		}
 	}
 	rewrite_ex(node);
+	// the children may have been replaced.
+	node->rehash();
 	rewrite_onback(node);
 }
 
+// Path copying: a node is changed in place only while this rewrite holds
+// its only reference, which is true of the nodes the rules just made.
+// Every node of the caller's tree has another reference, so it is copied
+// before one of its children is replaced, and so are its ancestors.
+Ast *AstRewriter::rewrite_persistent(Ast *node)
+{
+	Ast *current = node->retain();
+	for (auto rule : topdown_rules)
+	{
+		if (rule->match(current))
+		{
+			auto new_node = rule->rewrite(current);
+			Ast::release(current);
+			current = new_node;
+		}
+	}
+	bool changed = false;
+	for (size_t i = 0; i < current->child_count(); ++i)
+	{
+		auto child = current->child(i);
+		auto new_child = rewrite_persistent(child);
+		if (new_child == child)
+		{
+			Ast::release(new_child);
+			continue;
+		}
+		if (current->get_refs() > 1)
+		{
+			auto copy = current->shallow_copy();
+			Ast::release(current);
+			current = copy;
+		}
+		Ast::release(current->child(i));
+		current->set_child(i, new_child);
+		changed = true;
+	}
+	if (changed)
+		current->rehash();
+	for (auto rule : bottomup_rules)
+	{
+		if (rule->match(current))
+		{
+			auto new_node = rule->rewrite(current);
+			Ast::release(current);
+			current = new_node;
+		}
+	}
+	return current;
+}
+
 void AstRewriter::rewrite_onback(Ast *&node)
 {
 	Ast *new_node = nullptr;
@@ -218,108 +431,95 @@ void AstRewriter::rewrite_onback(Ast *&node)
 		if (rule->match(node))
 		{
 			new_node = rule->rewrite(node);
-			delete node;
+			Ast::release(node);
 			node = new_node;
 		}
 	}
 }
 
-void AstRewriter::rewrite_ex(Ast *&node)
+// hands a node to the rewrite_elements() overload for its class.
+class ElementRewriter : public StaticVisitor<ElementRewriter>
 {
-	switch (node->get_node_type())
+public:
+	ElementRewriter(AstRewriter &rewriter) : rewriter(rewriter) {}
+
+	template<class Node>
+	void visit(Node *node) const
 	{
-	case AstToken::ID:
-		rewrite_elements(reinterpret_cast<VarNode*&>(node));
-		break;
-	case AstToken::ASSIGN:
-		rewrite_elements(reinterpret_cast<AssignNode*&>(node));
-		break;
-	case AstToken::PRINT:
-		rewrite_elements(reinterpret_cast<PrintNode*&>(node));
-		break;
-	case AstToken::PLUS:
-		rewrite_elements(reinterpret_cast<AddNode*&>(node));
-		break;
-	case AstToken::MULT:
-		rewrite_elements(reinterpret_cast<MultNode*&>(node));
-		break;
-	case AstToken::DOT:
-		rewrite_elements(reinterpret_cast<DotProductNode*&>(node));
-		break;
-	case AstToken::INT:
-		rewrite_elements(reinterpret_cast<IntNode*&>(node));
-		break;
-	case AstToken::VEC:
-		rewrite_elements(reinterpret_cast<VecNode*&>(node));
-		break;
-	case AstToken::STAT_LIST:
-		rewrite_elements(reinterpret_cast<StatListNode*&>(node));
-		break;
-	case AstToken::LEFT_SHIFT:
-		rewrite_elements(reinterpret_cast<LeftShiftNode*&>(node));
-		break;
-	default:
-		rewrite_elements(node);
+		rewriter.rewrite_elements(node);
 	}
+
+	void visit_unknown(Ast *node) const
+	{
+		rewriter.rewrite_elements(node);
+	}
+
+private:
+	AstRewriter &rewriter;
+};
+
+void AstRewriter::rewrite_ex(Ast *&node)
+{
+	ElementRewriter(*this).dispatch(node);
 }
 
-void AstRewriter::rewrite_elements(Ast *&node)
+void AstRewriter::rewrite_elements(Ast *node)
 {
 
 }
 
-void AstRewriter::rewrite_elements(AssignNode *&node)
+void AstRewriter::rewrite_elements(AssignNode *node)
 {
 	rewrite(node->left);
 	rewrite(node->right);
 }
 
-void AstRewriter::rewrite_elements(PrintNode *&node)
+void AstRewriter::rewrite_elements(PrintNode *node)
 {
 	rewrite(node->element);
 }
 
-void AstRewriter::rewrite_elements(StatListNode *&node)
+void AstRewriter::rewrite_elements(StatListNode *node)
 {
 	for (auto &ele : node->elements)
 		rewrite(ele);
 }
 
-void AstRewriter::rewrite_elements(VarNode *&node)
+void AstRewriter::rewrite_elements(VarNode *node)
 {
 
 }
 
-void AstRewriter::rewrite_elements(AddNode *&node)
+void AstRewriter::rewrite_elements(AddNode *node)
 {
 	rewrite(node->left);
 	rewrite(node->right);
 }
 
-void AstRewriter::rewrite_elements(DotProductNode *&node)
+void AstRewriter::rewrite_elements(DotProductNode *node)
 {
 	rewrite(node->left);
 	rewrite(node->right);
 }
 
-void AstRewriter::rewrite_elements(IntNode *&node)
+void AstRewriter::rewrite_elements(IntNode *node)
 {
 
 }
 
-void AstRewriter::rewrite_elements(MultNode *&node)
+void AstRewriter::rewrite_elements(MultNode *node)
 {
 	rewrite(node->left);
 	rewrite(node->right);
 }
 
-void AstRewriter::rewrite_elements(VecNode *&node)
+void AstRewriter::rewrite_elements(VecNode *node)
 {
 	for (auto &ele : node->elements)
 		rewrite(ele);
 }
 
-void AstRewriter::rewrite_elements(LeftShiftNode *&node)
+void AstRewriter::rewrite_elements(LeftShiftNode *node)
 {
 	rewrite(node->left);
 	rewrite(node->right);
@@ -4,6 +4,9 @@
 #include "ast.h"
 
 
+// rewrite() leaves the matched node untouched and returns a new reference
+// to its replacement; parts of the old tree it reuses are retained, since
+// AstRewriter releases the old node afterwards.
 class Rule 
 {
 public:
@@ -83,6 +86,26 @@ public:
 	bool match(const Ast *node) const override;
 };
 
+// Evaluates arithmetic on literals: 1 + 4 becomes 5, 2 * [3, 4] becomes
+// [6, 8], [1, 2] . [3, 4] becomes 11 and [1, 2] << 3 becomes [8, 16].
+// As a BOTTOMUP rule it sees a node after its children are folded, so
+// one rewrite folds every constant subtree, shift chains included. Ints
+// wrap around on overflow; vectors of different lengths and shifts by 64
+// or more are left for the program to fail on.
+class ConstantFoldRule : public Rule
+{
+public:
+	ConstantFoldRule() = delete;
+	ConstantFoldRule(VISIT_ORDER order);
+	ConstantFoldRule(const ConstantFoldRule&) = delete;
+	Ast *rewrite(Ast *node) override;
+	bool match(const Ast *node) const override;
+	// nodes taken out of trees by the rewrites so far.
+	size_t get_removed() const;
+
+private:
+	size_t removed = 0;
+};
 
 class AstRewriter
 {
@@ -94,17 +117,21 @@ public:
 	void add_rule(Rule *rule);
 	void rewrite_ex(Ast *&node);
 	void rewrite(Ast *&node);
-	void rewrite_elements(Ast *&node);
-	void rewrite_elements(AssignNode *&node);
-	void rewrite_elements(PrintNode *&node);
-	void rewrite_elements(StatListNode *&node);
-	void rewrite_elements(VarNode *&node);
-	void rewrite_elements(AddNode *&node);
-	void rewrite_elements(DotProductNode *&node);
-	void rewrite_elements(IntNode *&node);
-	void rewrite_elements(MultNode *&node);
-	void rewrite_elements(VecNode *&node);
-	void rewrite_elements(LeftShiftNode *&node);
+	// Rewrites without changing node: returns a new reference to the
+	// result, which shares every unchanged subtree with node. Both trees
+	// stay valid; release the result with Ast::release().
+	Ast *rewrite_persistent(Ast *node);
+	void rewrite_elements(Ast *node);
+	void rewrite_elements(AssignNode *node);
+	void rewrite_elements(PrintNode *node);
+	void rewrite_elements(StatListNode *node);
+	void rewrite_elements(VarNode *node);
+	void rewrite_elements(AddNode *node);
+	void rewrite_elements(DotProductNode *node);
+	void rewrite_elements(IntNode *node);
+	void rewrite_elements(MultNode *node);
+	void rewrite_elements(VecNode *node);
+	void rewrite_elements(LeftShiftNode *node);
 	void rewrite_onback(Ast *&node);
 
 private:
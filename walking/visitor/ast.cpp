@@ -21,6 +21,16 @@ AstToken::AstToken(int type)
 	: type(type)
 {}
 
+void *AstToken::operator new(size_t size)
+{
+	return NodePool::allocate(size);
+}
+
+void AstToken::operator delete(void *p, size_t size)
+{
+	NodePool::deallocate(p, size);
+}
+
 std::string AstToken::to_string() const
 {
 	return text;
@@ -45,6 +55,39 @@ Ast::~Ast()
 	delete token;
 }
 
+void *Ast::operator new(size_t size)
+{
+	return NodePool::allocate(size);
+}
+
+void Ast::operator delete(void *p, size_t size)
+{
+	NodePool::deallocate(p, size);
+}
+
+void Ast::detach_children(std::vector<Ast*> &)
+{}
+
+// Subtrees are freed from an explicit stack rather than by recursion: each
+// node's children are detached before it is deleted, so deep trees cannot
+// overflow the call stack. The stack is kept per thread and reused; the
+// nodes deleted from the loop have no children left and return at once.
+void Ast::release_children()
+{
+	static thread_local std::vector<Ast*> stack;
+	auto base = stack.size();
+	detach_children(stack);
+	while (stack.size() > base)
+	{
+		auto node = stack.back();
+		stack.pop_back();
+		if (node == nullptr)
+			continue;
+		node->detach_children(stack);
+		delete node;
+	}
+}
+
 std::string Ast::to_string() const
 {
 	return token != nullptr ? token->to_string() : "nil";
@@ -58,16 +101,27 @@ int Ast::get_node_type() const
 void Ast::visit(AstVisitor *visitor) const
 {
 	visitor->visit(this);
+	visitor->flush();
 }
 
+void Ast::accept(NodeVisitor &) const
+{}
+
 AddNode::AddNode(Ast *left, AstToken *add, Ast *right)
 	:Ast(add), left(left), right(right) {}
 
 
 AddNode::~AddNode()
 {
-	delete left;
-	delete right;
+	release_children();
+}
+
+void AddNode::detach_children(std::vector<Ast*> &out)
+{
+	out.push_back(left);
+	out.push_back(right);
+	left = nullptr;
+	right = nullptr;
 }
 
 AssignNode::AssignNode(Ast *left, AstToken *assign, Ast *right)
@@ -75,8 +129,15 @@ AssignNode::AssignNode(Ast *left, AstToken *assign, Ast *right)
 
 AssignNode::~AssignNode()
 {
-	delete left;
-	delete right;
+	release_children();
+}
+
+void AssignNode::detach_children(std::vector<Ast*> &out)
+{
+	out.push_back(left);
+	out.push_back(right);
+	left = nullptr;
+	right = nullptr;
 }
 
 
@@ -86,12 +147,41 @@ DotProductNode::DotProductNode(Ast *left, AstToken *dot, Ast *right)
 
 DotProductNode::~DotProductNode()
 {
-	delete left;
-	delete right;
+	release_children();
+}
+
+void DotProductNode::detach_children(std::vector<Ast*> &out)
+{
+	out.push_back(left);
+	out.push_back(right);
+	left = nullptr;
+	right = nullptr;
 }
 
+// the literal text is only read here; the node prints its value.
 IntNode::IntNode(AstToken *token)
-	: Ast(token) {}
+	: Ast(token), value(parse(token->to_string())) {}
+
+IntNode::IntNode(int64_t value)
+	: Ast(AstToken::INT), value(value) {}
+
+int64_t IntNode::parse(const char *digits, size_t length)
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < length; ++i)
+		value = value * 10 + (digits[i] - '0');
+	return (int64_t)value;
+}
+
+int64_t IntNode::parse(const std::string &digits)
+{
+	return parse(digits.data(), digits.size());
+}
+
+std::string IntNode::to_string() const
+{
+	return std::to_string(value);
+}
 
 
 MultNode::MultNode(Ast *left, AstToken *mult, Ast *right)
@@ -99,8 +189,15 @@ MultNode::MultNode(Ast *left, AstToken *mult, Ast *right)
 
 MultNode::~MultNode()
 {
-	delete left;
-	delete right;
+	release_children();
+}
+
+void MultNode::detach_children(std::vector<Ast*> &out)
+{
+	out.push_back(left);
+	out.push_back(right);
+	left = nullptr;
+	right = nullptr;
 }
 
 
@@ -109,7 +206,13 @@ PrintNode::PrintNode(AstToken *pr, Ast *element)
 
 PrintNode::~PrintNode()
 {
-	delete element;
+	release_children();
+}
+
+void PrintNode::detach_children(std::vector<Ast*> &out)
+{
+	out.push_back(element);
+	element = nullptr;
 }
 
 
@@ -121,8 +224,13 @@ StatListNode::StatListNode(const std::initializer_list<Ast*> &elements)
 
 StatListNode::~StatListNode()
 {
-	for (auto ele : elements)
-		delete ele;
+	release_children();
+}
+
+void StatListNode::detach_children(std::vector<Ast*> &out)
+{
+	out.insert(out.end(), elements.begin(), elements.end());
+	elements.clear();
 }
 
 
@@ -130,7 +238,11 @@ VarNode::VarNode(AstToken *var)
 	: Ast(var) {}
 
 VecNode::VecNode(AstToken *token, std::vector<Ast*> &&elements)
-	: Ast(token), elements(std::forward<std::vector<Ast*>>(elements)) 
+	: Ast(token), elements(std::move(elements))
+{ }
+
+VecNode::VecNode(AstToken *token, Elements &&elements)
+	: Ast(token), elements(std::move(elements))
 { }
 
 VecNode::VecNode(AstToken *token, const std::initializer_list<Ast*> &elements)
@@ -139,108 +251,140 @@ VecNode::VecNode(AstToken *token, const std::initializer_list<Ast*> &elements)
 
 VecNode::~VecNode()
 {
-	for (auto ele : elements)
-		delete ele;
+	release_children();
+}
+
+void VecNode::detach_children(std::vector<Ast*> &out)
+{
+	out.insert(out.end(), elements.begin(), elements.end());
+	elements.clear();
+}
+
+void AddNode::accept(NodeVisitor &visitor) const
+{
+	visitor.visit(this);
+}
+
+void AssignNode::accept(NodeVisitor &visitor) const
+{
+	visitor.visit(this);
+}
+
+void DotProductNode::accept(NodeVisitor &visitor) const
+{
+	visitor.visit(this);
+}
+
+void IntNode::accept(NodeVisitor &visitor) const
+{
+	visitor.visit(this);
+}
+
+void MultNode::accept(NodeVisitor &visitor) const
+{
+	visitor.visit(this);
+}
+
+void PrintNode::accept(NodeVisitor &visitor) const
+{
+	visitor.visit(this);
+}
+
+void StatListNode::accept(NodeVisitor &visitor) const
+{
+	visitor.visit(this);
+}
+
+void VarNode::accept(NodeVisitor &visitor) const
+{
+	visitor.visit(this);
+}
+
+void VecNode::accept(NodeVisitor &visitor) const
+{
+	visitor.visit(this);
+}
+
+AstVisitor::AstVisitor(std::ostream &out)
+	: out(out)
+{}
+
+void AstVisitor::flush() const
+{
+	out.flush();
 }
 
 void AstVisitor::visit(const Ast *node) const
 {
-	Ast *n = const_cast<Ast*>(node);
-	switch (node->get_node_type())
-	{
-	case AstToken::ID:
-		visit(reinterpret_cast<VarNode*>(n));
-		break;
-	case AstToken::ASSIGN:
-		visit(reinterpret_cast<AssignNode*>(n));
-		break;
-	case AstToken::PRINT:
-		visit(reinterpret_cast<PrintNode*>(n));
-		break;
-	case AstToken::PLUS:
-		visit(reinterpret_cast<AddNode*>(n));
-		break;
-	case AstToken::MULT:
-		visit(reinterpret_cast<MultNode*>(n));
-		break;
-	case AstToken::DOT:
-		visit(reinterpret_cast<DotProductNode*>(n));
-		break;
-	case AstToken::INT:
-		visit(reinterpret_cast<IntNode*>(n));
-		break;
-	case AstToken::VEC:
-		visit(reinterpret_cast<VecNode*>(n));
-		break;
-	case AstToken::STAT_LIST:
-		visit(reinterpret_cast<StatListNode*>(n));
-		break;
-	default:
-		std::cout << "visit invalid type" << node->get_node_type() << " " << node->to_string() << std::endl;
-	}
+	dispatch(node);
+}
+
+void AstVisitor::visit_unknown(const Ast *node) const
+{
+	out << "visit invalid type" << node->get_node_type() << " " << node->to_string() << '\n';
 }
 
 void AstVisitor::visit(const AssignNode *node) const
 {
-	visit(node->left);
-	std::cout << " " << node->to_string() << " ";
-	visit(node->right);
+	dispatch(node->left);
+	out << " " << node->to_string() << " ";
+	dispatch(node->right);
 }
 
 void AstVisitor::visit(const PrintNode *node) const
 {
-	std::cout << node->to_string() << " ";
-	visit(node->element);
+	out << node->to_string() << " ";
+	dispatch(node->element);
 }
 
 void AstVisitor::visit(const StatListNode *node) const
 {
 	for (auto ele : node->elements)
 	{
-		visit(ele);
-		std::cout << std::endl;
+		dispatch(ele);
+		out << '\n';
 	}
 }
 
 void AstVisitor::visit(const VarNode *node) const
 {
-	std::cout << node->to_string();
+	out << node->to_string();
 }
 
 void AstVisitor::visit(const AddNode *node) const
 {
-	visit(node->left);
-	std::cout << " " << node->to_string() << " ";
-	visit(node->right);
+	dispatch(node->left);
+	out << " " << node->to_string() << " ";
+	dispatch(node->right);
 }
 
 void AstVisitor::visit(const DotProductNode *node) const
 {
-	visit(node->left);
-	std::cout << " " << node->to_string() << " ";
-	visit(node->right);
+	dispatch(node->left);
+	out << " " << node->to_string() << " ";
+	dispatch(node->right);
 }
 
 void AstVisitor::visit(const IntNode *node) const
 {
-	std::cout << node->to_string();
+	out << node->value;
 }
 
 void AstVisitor::visit(const MultNode *node) const
 {
-	visit(node->left);
-	std::cout << " " << node->to_string() << " ";
-	visit(node->right);
+	dispatch(node->left);
+	out << " " << node->to_string() << " ";
+	dispatch(node->right);
 }
 
 void AstVisitor::visit(const VecNode *node) const
 {
-	std::cout << " [";
-	std::cout << node->to_string();
+	out << " [";
+	out << node->to_string();
 	for (auto ele : node->elements)
 	{
-		visit(ele);
-		std::cout << ", ";
+		dispatch(ele);
+		out << ", ";
 	}
-	std::cout << "] ";
+	out << "] ";
 }
@@ -1,7 +1,12 @@
 #ifndef _AST_H
 #define _AST_H
 
+#include "node_pool.h"
+#include "output_sink.h"
+#include "small_vector.h"
+#include <cstdint>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <sstream>
 #include <iostream>
@@ -25,6 +30,9 @@ public:
 	AstToken(int type);
 	std::string to_string() const;
 	int get_type() const;
+	// storage from NodePool, as for nodes.
+	static void *operator new(size_t size);
+	static void operator delete(void *p, size_t size);
 
 private:
 	int type;
@@ -34,6 +42,7 @@ private:
 
 
 class AstVisitor;
+class NodeVisitor;
 
 class Ast
 {
@@ -42,13 +51,24 @@ public:
 	Ast(AstToken *token);
 	Ast(int type);
 	virtual ~Ast();
+	// nodes and tokens take their storage from NodePool.
+	static void *operator new(size_t size);
+	static void operator delete(void *p, size_t size);
+
+	// moves the node's children to out and forgets them, so the node can
+	// be deleted without touching its subtree.
+	virtual void detach_children(std::vector<Ast*> &out);
 
 	int get_node_type() const;
 	virtual std::string to_string() const;
 
 	virtual void visit(AstVisitor *visitor) const;
+	// calls the visitor overload for the node's own class.
+	virtual void accept(NodeVisitor &visitor) const;
 
 protected:
+	void release_children();
+
 	AstToken *token = nullptr;
 };
 
@@ -58,6 +78,8 @@ class AddNode :public Ast
 public:
 	AddNode(Ast *left, AstToken *add, Ast *right);
 	~AddNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	void accept(NodeVisitor &visitor) const override;
 
 	Ast *left;
 	Ast *right;
@@ -68,6 +90,8 @@ class AssignNode : public Ast
 public:
 	AssignNode(Ast *left, AstToken *assign, Ast *right);
 	~AssignNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	void accept(NodeVisitor &visitor) const override;
 
 	Ast *left;
 	Ast *right;
@@ -78,6 +102,8 @@ class DotProductNode : public Ast
 public:
 	DotProductNode(Ast *left, AstToken *dot, Ast *right);
 	~DotProductNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	void accept(NodeVisitor &visitor) const override;
 
 	Ast *left;
 	Ast *right;
@@ -87,6 +113,15 @@ class IntNode :public Ast
 {
 public:
 	IntNode(AstToken *token);
+	IntNode(int64_t value);
+	std::string to_string() const override;
+	// the value of a run of decimal digits; wraps around like int64_t
+	// arithmetic, so the lexer and this class agree on every literal.
+	static int64_t parse(const char *digits, size_t length);
+	static int64_t parse(const std::string &digits);
+	void accept(NodeVisitor &visitor) const override;
+
+	int64_t value;
 };
 
 class MultNode : public Ast
@@ -94,6 +129,8 @@ class MultNode : public Ast
 public:
 	MultNode(Ast *left, AstToken *mult, Ast *right);
 	~MultNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	void accept(NodeVisitor &visitor) const override;
 
 	Ast *left;
 	Ast *right;
@@ -104,6 +141,8 @@ class PrintNode : public Ast
 public:
 	PrintNode(AstToken *pr, Ast *element);
 	~PrintNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	void accept(NodeVisitor &visitor) const override;
 
 	Ast *element;
 };
@@ -114,33 +153,145 @@ public:
 	StatListNode(const std::vector<Ast*> &elements);
 	StatListNode(const std::initializer_list<Ast*> &elements);
 	~StatListNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	void accept(NodeVisitor &visitor) const override;
 
-	std::vector<Ast*> elements;
+	SmallVector<Ast*, 4> elements;
 };
 
 class VarNode : public Ast
 {
 public:
 	VarNode(AstToken *var);
+	void accept(NodeVisitor &visitor) const override;
+
+	// the variable's index in an Interpreter, set by SlotResolver; -1
+	// until the node is resolved.
+	int slot = -1;
 };
 
 
 class VecNode : public Ast
 {
 public:
+	// up to four elements are stored in the node.
+	typedef SmallVector<Ast*, 4> Elements;
+
 	VecNode(AstToken *token, std::vector<Ast*> &&elements);
+	VecNode(AstToken *token, Elements &&elements);
 	VecNode(AstToken *token, const std::initializer_list<Ast*> &elements);
 	~VecNode();
+	void detach_children(std::vector<Ast*> &out) override;
+	void accept(NodeVisitor &visitor) const override;
+
+	Elements elements;
+
+};
+
+// The virtual counterpart of StaticVisitor: Ast::accept() calls the
+// overload for the node's class through the vtable.
+class NodeVisitor
+{
+public:
+	virtual ~NodeVisitor() = default;
+	virtual void visit(const AssignNode *node) = 0;
+	virtual void visit(const PrintNode *node) = 0;
+	virtual void visit(const StatListNode *node) = 0;
+	virtual void visit(const VarNode *node) = 0;
+	virtual void visit(const AddNode *node) = 0;
+	virtual void visit(const DotProductNode *node) = 0;
+	virtual void visit(const IntNode *node) = 0;
+	virtual void visit(const MultNode *node) = 0;
+	virtual void visit(const VecNode *node) = 0;
+};
 
-	std::vector<Ast*> elements;
+// Dispatch on the node class without virtual calls or reinterpret_cast.
+// Derived has a visit() overload for each node class; dispatch() looks at
+// the token type once, static_casts the node to its class and calls the
+// overload directly, so the compiler checks every cast and can inline the
+// bodies:
+//
+//   class IntCounter : public StaticVisitor<IntCounter, int>
+//   {
+//   public:
+//       int visit(const IntNode *node) const { return 1; }
+//       template<class Node> int visit(const Node *node) const { return 0; }
+//   };
+//
+// A const node is passed on as const. Nodes of an unknown type go to
+// visit_unknown(), which Derived may declare as well.
+template<class Derived, class R = void>
+class StaticVisitor
+{
+public:
+	R dispatch(Ast *node)
+	{
+		return dispatch(static_cast<Derived&>(*this), node);
+	}
+
+	R dispatch(const Ast *node)
+	{
+		return dispatch(static_cast<Derived&>(*this), node);
+	}
+
+	R dispatch(Ast *node) const
+	{
+		return dispatch(static_cast<const Derived&>(*this), node);
+	}
+
+	R dispatch(const Ast *node) const
+	{
+		return dispatch(static_cast<const Derived&>(*this), node);
+	}
+
+	R visit_unknown(const Ast *node) const
+	{
+		return R();
+	}
 
+private:
+	// T with the constness of Node.
+	template<class T, class Node>
+	using Like = typename std::conditional<std::is_const<Node>::value, const T, T>::type;
+
+	template<class Self, class Node>
+	static R dispatch(Self &self, Node *node)
+	{
+		switch (node->get_node_type())
+		{
+		case AstToken::ID:
+			return self.visit(static_cast<Like<VarNode, Node>*>(node));
+		case AstToken::ASSIGN:
+			return self.visit(static_cast<Like<AssignNode, Node>*>(node));
+		case AstToken::PRINT:
+			return self.visit(static_cast<Like<PrintNode, Node>*>(node));
+		case AstToken::PLUS:
+			return self.visit(static_cast<Like<AddNode, Node>*>(node));
+		case AstToken::MULT:
+			return self.visit(static_cast<Like<MultNode, Node>*>(node));
+		case AstToken::DOT:
+			return self.visit(static_cast<Like<DotProductNode, Node>*>(node));
+		case AstToken::INT:
+			return self.visit(static_cast<Like<IntNode, Node>*>(node));
+		case AstToken::VEC:
+			return self.visit(static_cast<Like<VecNode, Node>*>(node));
+		case AstToken::STAT_LIST:
+			return self.visit(static_cast<Like<StatListNode, Node>*>(node));
+		default:
+			return self.visit_unknown(node);
+		}
+	}
 };
 
-class AstVisitor
+// Prints the nodes through an OutputSink. The text is buffered until
+// flush(); Ast::visit(), the entry point, flushes when it returns.
+class AstVisitor : public StaticVisitor<AstVisitor>
 {
 public:
-	AstVisitor() = default;
+	AstVisitor(std::ostream &out = std::cout);
+	void flush() const;
 	void visit(const Ast *node) const;
+	void visit_unknown(const Ast *node) const;
 	void visit(const AssignNode *node) const;
 	void visit(const PrintNode *node) const;
 	void visit(const StatListNode *node) const;
@@ -150,6 +301,9 @@ public:
 	void visit(const IntNode *node) const;
 	void visit(const MultNode *node) const;
 	void visit(const VecNode *node) const;
+
+private:
+	mutable OutputSink out;
 };
 
 #endif // !_AST_H
@@ -0,0 +1,325 @@
+#include "bytecode.h"
+#include <sstream>
+
+namespace
+{
+	const char *op_names[] = {
+		"load_int", "load_vec", "move_int", "move_vec", "add_int", "add_vec", "mult_int",
+		"scale_vec", "mult_vec", "shift_int", "shift_vec", "dot", "print_int", "print_vec", "halt",
+	};
+
+	// log2 of a literal power of two above 1, else -1.
+	int shift_of(const Ast *node)
+	{
+		if (node->get_node_type() != AstToken::INT)
+			return -1;
+		auto value = static_cast<const IntNode*>(node)->value;
+		if (value < 2 || (value & (value - 1)) != 0)
+			return -1;
+		int shift = 0;
+		while (value > 1)
+		{
+			value >>= 1;
+			++shift;
+		}
+		return shift;
+	}
+
+	const char *kind_name(const Operand &operand)
+	{
+		return operand.kind == Operand::INT ? "int" : operand.kind == Operand::VEC ? "vector" : "nothing";
+	}
+}
+
+std::string Bytecode::to_string() const
+{
+	std::ostringstream s;
+	for (size_t i = 0; i < code.size(); ++i)
+	{
+		auto &ins = code[i];
+		s << i << ": " << op_names[(int)ins.op] << " " << ins.dst << ", " << ins.a << ", "
+			<< ins.b << ", " << ins.n << "\n";
+	}
+	return s.str();
+}
+
+
+BytecodeCompiler::BytecodeCompiler(std::ostream &errors)
+	: errors(errors) {}
+
+bool BytecodeCompiler::compile(const Ast *program, Bytecode &out)
+{
+	code = &out;
+	code->code.clear();
+	code->constants.clear();
+	code->registers = 0;
+	variables.clear();
+	free_blocks.clear();
+	failed = false;
+	dispatch(program);
+	emit(Op::HALT, 0, 0);
+	code = nullptr;
+	return !failed;
+}
+
+void BytecodeCompiler::emit(Op op, uint32_t dst, uint32_t a, uint32_t b, uint32_t n)
+{
+	code->code.push_back(Instruction{ op, dst, a, b, n });
+}
+
+// takes a free block of the size when there is one, so registers are
+// reused as soon as their values are dead.
+Operand BytecodeCompiler::temp(Operand::Kind kind, uint32_t length)
+{
+	Operand operand;
+	operand.kind = kind;
+	operand.length = length;
+	operand.temp = true;
+	auto size = kind == Operand::VEC ? length : 1;
+	auto &blocks = free_blocks[size];
+	if (!blocks.empty())
+	{
+		operand.reg = blocks.back();
+		blocks.pop_back();
+	}
+	else
+	{
+		operand.reg = code->registers;
+		code->registers += size;
+	}
+	return operand;
+}
+
+uint32_t BytecodeCompiler::constant(int64_t value)
+{
+	code->constants.push_back(value);
+	return (uint32_t)(code->constants.size() - 1);
+}
+
+void BytecodeCompiler::release(const Operand &operand)
+{
+	if (operand.temp && operand.kind != Operand::NONE)
+		free_blocks[operand.kind == Operand::VEC ? operand.length : 1].push_back(operand.reg);
+}
+
+Operand BytecodeCompiler::error(const std::string &message)
+{
+	if (!failed)
+		errors << "compile error: " << message << std::endl;
+	failed = true;
+	return Operand();
+}
+
+Operand BytecodeCompiler::visit(const VarNode *node)
+{
+	auto found = variables.find(node->to_string());
+	if (found == variables.end())
+		return error("undefined variable " + node->to_string());
+	return found->second;
+}
+
+Operand BytecodeCompiler::visit(const AssignNode *node)
+{
+	if (node->left->get_node_type() != AstToken::ID)
+		return error("cannot assign to " + node->left->to_string());
+	auto value = dispatch(node->right);
+	if (failed)
+		return Operand();
+	// another variable's registers are copied, not shared.
+	if (!value.temp)
+	{
+		auto copy = temp(value.kind, value.length);
+		if (value.kind == Operand::INT)
+			emit(Op::MOVE_INT, copy.reg, value.reg);
+		else
+			emit(Op::MOVE_VEC, copy.reg, value.reg, 0, value.length);
+		value = copy;
+	}
+	auto name = node->left->to_string();
+	auto found = variables.find(name);
+	if (found != variables.end())
+	{
+		auto old = found->second;
+		old.temp = true;
+		release(old);
+	}
+	value.temp = false;
+	variables[name] = value;
+	return Operand();
+}
+
+Operand BytecodeCompiler::visit(const PrintNode *node)
+{
+	auto value = dispatch(node->element);
+	if (failed)
+		return Operand();
+	if (value.kind == Operand::INT)
+		emit(Op::PRINT_INT, 0, value.reg);
+	else
+		emit(Op::PRINT_VEC, 0, value.reg, 0, value.length);
+	release(value);
+	return Operand();
+}
+
+Operand BytecodeCompiler::visit(const AddNode *node)
+{
+	auto left = dispatch(node->left);
+	if (failed)
+		return Operand();
+	auto right = dispatch(node->right);
+	if (failed)
+		return Operand();
+	release(left);
+	release(right);
+	if (left.kind == Operand::INT && right.kind == Operand::INT)
+	{
+		auto sum = temp(Operand::INT, 1);
+		emit(Op::ADD_INT, sum.reg, left.reg, right.reg);
+		return sum;
+	}
+	if (left.kind == Operand::VEC && right.kind == Operand::VEC && left.length == right.length)
+	{
+		auto sum = temp(Operand::VEC, left.length);
+		emit(Op::ADD_VEC, sum.reg, left.reg, right.reg, left.length);
+		return sum;
+	}
+	return error(std::string("cannot add ") + kind_name(left) + " and " + kind_name(right));
+}
+
+Operand BytecodeCompiler::visit(const MultNode *node)
+{
+	// x * 2^k, or 2^k * x, shifts x.
+	auto shift = shift_of(node->right);
+	auto other = node->left;
+	if (shift < 0)
+	{
+		shift = shift_of(node->left);
+		other = node->right;
+	}
+	if (shift >= 0)
+	{
+		auto value = dispatch(other);
+		if (failed)
+			return Operand();
+		release(value);
+		auto product = temp(value.kind, value.length);
+		if (value.kind == Operand::INT)
+			emit(Op::SHIFT_INT, product.reg, value.reg, (uint32_t)shift);
+		else
+			emit(Op::SHIFT_VEC, product.reg, value.reg, (uint32_t)shift, value.length);
+		return product;
+	}
+
+	auto left = dispatch(node->left);
+	if (failed)
+		return Operand();
+	auto right = dispatch(node->right);
+	if (failed)
+		return Operand();
+	release(left);
+	release(right);
+	if (left.kind == Operand::INT && right.kind == Operand::INT)
+	{
+		auto product = temp(Operand::INT, 1);
+		emit(Op::MULT_INT, product.reg, left.reg, right.reg);
+		return product;
+	}
+	if (left.kind == Operand::INT && right.kind == Operand::VEC)
+	{
+		auto product = temp(Operand::VEC, right.length);
+		emit(Op::SCALE_VEC, product.reg, left.reg, right.reg, right.length);
+		return product;
+	}
+	if (left.kind == Operand::VEC && right.kind == Operand::INT)
+	{
+		auto product = temp(Operand::VEC, left.length);
+		emit(Op::SCALE_VEC, product.reg, right.reg, left.reg, left.length);
+		return product;
+	}
+	if (left.kind == Operand::VEC && right.kind == Operand::VEC && left.length == right.length)
+	{
+		auto product = temp(Operand::VEC, left.length);
+		emit(Op::MULT_VEC, product.reg, left.reg, right.reg, left.length);
+		return product;
+	}
+	return error(std::string("cannot multiply ") + kind_name(left) + " and " + kind_name(right));
+}
+
+Operand BytecodeCompiler::visit(const DotProductNode *node)
+{
+	auto left = dispatch(node->left);
+	if (failed)
+		return Operand();
+	auto right = dispatch(node->right);
+	if (failed)
+		return Operand();
+	release(left);
+	release(right);
+	if (left.kind != Operand::VEC || right.kind != Operand::VEC || left.length != right.length)
+	{
+		return error(std::string("cannot take the dot product of ") + kind_name(left) + " and "
+			+ kind_name(right));
+	}
+	auto sum = temp(Operand::INT, 1);
+	emit(Op::DOT, sum.reg, left.reg, right.reg, left.length);
+	return sum;
+}
+
+Operand BytecodeCompiler::visit(const IntNode *node)
+{
+	auto value = temp(Operand::INT, 1);
+	emit(Op::LOAD_INT, value.reg, constant(node->value));
+	return value;
+}
+
+// a literal of literals is one load from the constants; otherwise each
+// element is computed and moved into place.
+Operand BytecodeCompiler::visit(const VecNode *node)
+{
+	auto length = (uint32_t)node->elements.size();
+	auto vec = temp(Operand::VEC, length);
+	bool literal = true;
+	for (auto ele : node->elements)
+		literal = literal && ele->get_node_type() == AstToken::INT;
+	if (literal)
+	{
+		auto first = (uint32_t)code->constants.size();
+		for (auto ele : node->elements)
+			code->constants.push_back(static_cast<const IntNode*>(ele)->value);
+		emit(Op::LOAD_VEC, vec.reg, first, 0, length);
+		return vec;
+	}
+	for (uint32_t i = 0; i < length; ++i)
+	{
+		auto ele = node->elements[i];
+		if (ele->get_node_type() == AstToken::INT)
+		{
+			emit(Op::LOAD_INT, vec.reg + i, constant(static_cast<const IntNode*>(ele)->value));
+			continue;
+		}
+		auto value = dispatch(ele);
+		if (failed)
+			return Operand();
+		if (value.kind != Operand::INT)
+			return error("vector elements must be ints, found " + ele->to_string());
+		emit(Op::MOVE_INT, vec.reg + i, value.reg);
+		release(value);
+	}
+	return vec;
+}
+
+Operand BytecodeCompiler::visit(const StatListNode *node)
+{
+	for (auto ele : node->elements)
+	{
+		release(dispatch(ele));
+		if (failed)
+			break;
+	}
+	return Operand();
+}
+
+Operand BytecodeCompiler::visit_unknown(const Ast *node)
+{
+	return error("cannot compile " + node->to_string());
+}
@@ -0,0 +1,113 @@
+#ifndef _BYTECODE_H
+#define _BYTECODE_H
+
+#include "ast.h"
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The instruction set of the VM. Registers are int64 cells of one file;
+// an int takes one register and a vector of n elements n consecutive
+// ones, so an instruction names the first register of each operand and,
+// for vectors, the length n.
+enum class Op : uint8_t
+{
+	LOAD_INT,     // r[dst] = constants[a]
+	LOAD_VEC,     // r[dst..dst+n) = constants[a..a+n)
+	MOVE_INT,     // r[dst] = r[a]
+	MOVE_VEC,     // r[dst..dst+n) = r[a..a+n)
+	ADD_INT,      // r[dst] = r[a] + r[b]
+	ADD_VEC,      // r[dst+i] = r[a+i] + r[b+i]
+	MULT_INT,     // r[dst] = r[a] * r[b]
+	SCALE_VEC,    // r[dst+i] = r[a] * r[b+i]
+	MULT_VEC,     // r[dst+i] = r[a+i] * r[b+i]
+	SHIFT_INT,    // r[dst] = r[a] << b
+	SHIFT_VEC,    // r[dst+i] = r[a+i] << b
+	DOT,          // r[dst] = sum of r[a+i] * r[b+i]
+	PRINT_INT,    // prints r[a]
+	PRINT_VEC,    // prints r[a..a+n)
+	HALT,
+};
+
+struct Instruction
+{
+	Op op;
+	uint32_t dst;
+	uint32_t a;
+	uint32_t b;
+	uint32_t n;
+};
+
+// A compiled program: its code, ending in HALT, the constants it loads
+// and the size of the register file it needs.
+struct Bytecode
+{
+	std::vector<Instruction> code;
+	std::vector<int64_t> constants;
+	uint32_t registers = 0;
+
+	// one instruction per line, for reading the compiler's output.
+	std::string to_string() const;
+};
+
+// Where the compiler left an expression's value.
+struct Operand
+{
+	enum Kind { NONE, INT, VEC };
+
+	// NONE for statements and for expressions that failed to compile.
+	Kind kind = NONE;
+	uint32_t reg = 0;
+	uint32_t length = 0;
+	// a temporary is freed once used; a variable keeps its registers.
+	bool temp = false;
+};
+
+// Compiles a program to Bytecode. Programs have no branches, so the type
+// of every value, and the length of every vector, is known as it is
+// compiled: using an undefined variable or mixing vectors of different
+// lengths is a compile error, and the VM checks nothing while it runs.
+//
+// An assignment makes the register its expression left the value in the
+// variable's; the old one, like each temporary once used, goes back to a
+// free list for its size. A multiplication by a literal power of two
+// becomes a shift.
+class BytecodeCompiler : public StaticVisitor<BytecodeCompiler, Operand>
+{
+public:
+	// compile errors are printed to errors; give it the VM's stream so
+	// they land with the program's output.
+	BytecodeCompiler(std::ostream &errors = std::cout);
+
+	// false, with a message printed, if the program does not compile.
+	bool compile(const Ast *program, Bytecode &out);
+
+	Operand visit(const VarNode *node);
+	Operand visit(const AssignNode *node);
+	Operand visit(const PrintNode *node);
+	Operand visit(const AddNode *node);
+	Operand visit(const MultNode *node);
+	Operand visit(const DotProductNode *node);
+	Operand visit(const IntNode *node);
+	Operand visit(const VecNode *node);
+	Operand visit(const StatListNode *node);
+	Operand visit_unknown(const Ast *node);
+
+private:
+	void emit(Op op, uint32_t dst, uint32_t a, uint32_t b = 0, uint32_t n = 0);
+	Operand temp(Operand::Kind kind, uint32_t length);
+	uint32_t constant(int64_t value);
+	void release(const Operand &operand);
+	Operand error(const std::string &message);
+
+	std::ostream &errors;
+	Bytecode *code = nullptr;
+	std::unordered_map<std::string, Operand> variables;
+	// free registers, by the size of the block.
+	std::unordered_map<uint32_t, std::vector<uint32_t>> free_blocks;
+	bool failed = false;
+};
+
+#endif // !_BYTECODE_H
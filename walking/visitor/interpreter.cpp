@@ -0,0 +1,306 @@
+#include "interpreter.h"
+#include "vec_kernels.h"
+
+namespace
+{
+	// signed overflow is undefined; the interpreter's ints wrap instead.
+	int64_t wrap_add(int64_t a, int64_t b)
+	{
+		return (int64_t)((uint64_t)a + (uint64_t)b);
+	}
+
+	int64_t wrap_mult(int64_t a, int64_t b)
+	{
+		return (int64_t)((uint64_t)a * (uint64_t)b);
+	}
+
+	const char *kind_name(const Value &value)
+	{
+		return value.kind == Value::INT ? "int" : value.kind == Value::VEC ? "vector" : "nothing";
+	}
+
+	const Value none = Value();
+}
+
+Value::Value(int64_t scalar)
+	: kind(INT), scalar(scalar) {}
+
+Value::Value(SmallVector<int64_t, 4> &&elements)
+	: kind(VEC), elements(std::move(elements)) {}
+
+std::string Value::to_string() const
+{
+	if (kind == INT)
+		return std::to_string(scalar);
+	if (kind == NONE)
+		return "nil";
+	std::string s = "[";
+	for (size_t i = 0; i < elements.size(); ++i)
+	{
+		if (i != 0)
+			s += ", ";
+		s += std::to_string(elements[i]);
+	}
+	return s + "]";
+}
+
+
+size_t SlotResolver::resolve(Ast *program)
+{
+	dispatch(program);
+	return slots.size();
+}
+
+size_t SlotResolver::size() const
+{
+	return slots.size();
+}
+
+int SlotResolver::slot(const std::string &name) const
+{
+	auto found = slots.find(name);
+	return found != slots.end() ? found->second : -1;
+}
+
+void SlotResolver::visit(VarNode *node)
+{
+	auto found = slots.emplace(node->to_string(), (int)slots.size());
+	node->slot = found.first->second;
+}
+
+void SlotResolver::visit(AssignNode *node)
+{
+	dispatch(node->left);
+	dispatch(node->right);
+}
+
+void SlotResolver::visit(PrintNode *node)
+{
+	dispatch(node->element);
+}
+
+void SlotResolver::visit(AddNode *node)
+{
+	dispatch(node->left);
+	dispatch(node->right);
+}
+
+void SlotResolver::visit(MultNode *node)
+{
+	dispatch(node->left);
+	dispatch(node->right);
+}
+
+void SlotResolver::visit(DotProductNode *node)
+{
+	dispatch(node->left);
+	dispatch(node->right);
+}
+
+void SlotResolver::visit(IntNode *)
+{}
+
+void SlotResolver::visit(VecNode *node)
+{
+	for (auto ele : node->elements)
+		dispatch(ele);
+}
+
+void SlotResolver::visit(StatListNode *node)
+{
+	for (auto ele : node->elements)
+		dispatch(ele);
+}
+
+void SlotResolver::visit_unknown(Ast *)
+{}
+
+
+Interpreter::Interpreter(std::ostream &out)
+	: out(out) {}
+
+bool Interpreter::run(Ast *program)
+{
+	resolver.resolve(program);
+	return execute(program);
+}
+
+bool Interpreter::execute(const Ast *program)
+{
+	failed = false;
+	if (slots.size() < resolver.size())
+		slots.resize(resolver.size());
+	dispatch(program);
+	out.flush();
+	return !failed;
+}
+
+const Value &Interpreter::get(const std::string &name) const
+{
+	auto slot = resolver.slot(name);
+	return slot >= 0 && (size_t)slot < slots.size() ? slots[slot] : none;
+}
+
+Value Interpreter::error(const std::string &message)
+{
+	out << "runtime error: " << message << '\n';
+	out.flush();
+	failed = true;
+	return Value();
+}
+
+Value Interpreter::visit(const VarNode *node)
+{
+	if (node->slot < 0 || (size_t)node->slot >= slots.size())
+		return error("unresolved variable " + node->to_string());
+	auto &value = slots[node->slot];
+	if (value.kind == Value::NONE)
+		return error("undefined variable " + node->to_string());
+	return value;
+}
+
+Value Interpreter::visit(const AssignNode *node)
+{
+	if (node->left->get_node_type() != AstToken::ID)
+		return error("cannot assign to " + node->left->to_string());
+	auto var = static_cast<const VarNode*>(node->left);
+	if (var->slot < 0 || (size_t)var->slot >= slots.size())
+		return error("unresolved variable " + var->to_string());
+	auto value = dispatch(node->right);
+	if (failed)
+		return Value();
+	slots[var->slot] = std::move(value);
+	return Value();
+}
+
+Value Interpreter::visit(const PrintNode *node)
+{
+	auto value = dispatch(node->element);
+	if (failed)
+		return Value();
+	if (value.kind == Value::INT)
+		out << value.scalar;
+	else
+	{
+		out << '[';
+		for (size_t i = 0; i < value.elements.size(); ++i)
+		{
+			if (i != 0)
+				out << ", ";
+			out << value.elements[i];
+		}
+		out << ']';
+	}
+	out << '\n';
+	return Value();
+}
+
+Value Interpreter::visit(const AddNode *node)
+{
+	auto left = dispatch(node->left);
+	if (failed)
+		return Value();
+	auto right = dispatch(node->right);
+	if (failed)
+		return Value();
+	if (left.kind == Value::INT && right.kind == Value::INT)
+		return Value(wrap_add(left.scalar, right.scalar));
+	if (left.kind == Value::VEC && right.kind == Value::VEC
+		&& left.elements.size() == right.elements.size())
+	{
+		VecKernels::add(left.elements.data(), right.elements.data(), left.elements.data(), left.elements.size());
+		return left;
+	}
+	return error(std::string("cannot add ") + kind_name(left) + " and " + kind_name(right)
+		+ ": " + left.to_string() + " + " + right.to_string());
+}
+
+Value Interpreter::visit(const MultNode *node)
+{
+	auto left = dispatch(node->left);
+	if (failed)
+		return Value();
+	auto right = dispatch(node->right);
+	if (failed)
+		return Value();
+	if (left.kind == Value::INT && right.kind == Value::INT)
+		return Value(wrap_mult(left.scalar, right.scalar));
+	if (left.kind == Value::INT && right.kind == Value::VEC)
+	{
+		VecKernels::scale(left.scalar, right.elements.data(), right.elements.data(), right.elements.size());
+		return right;
+	}
+	if (left.kind == Value::VEC && right.kind == Value::INT)
+	{
+		VecKernels::scale(right.scalar, left.elements.data(), left.elements.data(), left.elements.size());
+		return left;
+	}
+	if (left.kind == Value::VEC && right.kind == Value::VEC
+		&& left.elements.size() == right.elements.size())
+	{
+		VecKernels::mult(left.elements.data(), right.elements.data(), left.elements.data(), left.elements.size());
+		return left;
+	}
+	return error(std::string("cannot multiply ") + kind_name(left) + " and " + kind_name(right)
+		+ ": " + left.to_string() + " * " + right.to_string());
+}
+
+Value Interpreter::visit(const DotProductNode *node)
+{
+	auto left = dispatch(node->left);
+	if (failed)
+		return Value();
+	auto right = dispatch(node->right);
+	if (failed)
+		return Value();
+	if (left.kind != Value::VEC || right.kind != Value::VEC
+		|| left.elements.size() != right.elements.size())
+	{
+		return error(std::string("cannot take the dot product of ") + kind_name(left) + " and "
+			+ kind_name(right) + ": " + left.to_string() + " . " + right.to_string());
+	}
+	return Value(VecKernels::dot(left.elements.data(), right.elements.data(), left.elements.size()));
+}
+
+Value Interpreter::visit(const IntNode *node)
+{
+	return Value(node->value);
+}
+
+Value Interpreter::visit(const VecNode *node)
+{
+	SmallVector<int64_t, 4> elements;
+	elements.reserve(node->elements.size());
+	for (auto ele : node->elements)
+	{
+		// literal elements are copied straight into the buffer.
+		if (ele->get_node_type() == AstToken::INT)
+		{
+			elements.push_back(static_cast<const IntNode*>(ele)->value);
+			continue;
+		}
+		auto value = dispatch(ele);
+		if (failed)
+			return Value();
+		if (value.kind != Value::INT)
+			return error("vector elements must be ints, found " + value.to_string());
+		elements.push_back(value.scalar);
+	}
+	return Value(std::move(elements));
+}
+
+Value Interpreter::visit(const StatListNode *node)
+{
+	for (auto ele : node->elements)
+	{
+		dispatch(ele);
+		if (failed)
+			break;
+	}
+	return Value();
+}
+
+Value Interpreter::visit_unknown(const Ast *node)
+{
+	return error("cannot evaluate " + node->to_string());
+}
@@ -0,0 +1,102 @@
+#ifndef _INTERPRETER_H
+#define _INTERPRETER_H
+
+#include "ast.h"
+#include "output_sink.h"
+#include "small_vector.h"
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// What an expression evaluates to: an int or a vector of ints. Statements
+// give NONE, as does an expression that failed.
+struct Value
+{
+	enum Kind { NONE, INT, VEC };
+
+	Value() = default;
+	Value(int64_t scalar);
+	Value(SmallVector<int64_t, 4> &&elements);
+
+	std::string to_string() const;
+
+	Kind kind = NONE;
+	int64_t scalar = 0;
+	// vectors of up to four elements are stored in the value.
+	SmallVector<int64_t, 4> elements;
+};
+
+// Numbers every variable of a program by its name, in order of first
+// appearance, and stores the number in VarNode::slot. Names keep their
+// slots across programs resolved by the same resolver.
+class SlotResolver : public StaticVisitor<SlotResolver>
+{
+public:
+	// returns the number of slots in use.
+	size_t resolve(Ast *program);
+	size_t size() const;
+	// the slot of a variable, -1 for a name not seen yet.
+	int slot(const std::string &name) const;
+
+	void visit(VarNode *node);
+	void visit(AssignNode *node);
+	void visit(PrintNode *node);
+	void visit(AddNode *node);
+	void visit(MultNode *node);
+	void visit(DotProductNode *node);
+	void visit(IntNode *node);
+	void visit(VecNode *node);
+	void visit(StatListNode *node);
+	void visit_unknown(Ast *node);
+
+private:
+	std::unordered_map<std::string, int> slots;
+};
+
+// Runs programs made of assignments and prints:
+//
+//   Interpreter interpreter;
+//   interpreter.run(program);    // x = 1 + 4; print x * [2, 3, 4]
+//
+// prints [10, 15, 20]. Variables are read and written by the slot the
+// resolver gave them, an index into an array of values. Arithmetic on
+// ints wraps around; vectors are added and multiplied element by element
+// and a scalar multiplies every element, through VecKernels. A runtime
+// error prints a message to the same stream and stops the program.
+class Interpreter : public StaticVisitor<Interpreter, Value>
+{
+public:
+	Interpreter(std::ostream &out = std::cout);
+
+	// resolves the program's variables, then executes it.
+	bool run(Ast *program);
+	// executes a program whose variables are already resolved, by this
+	// interpreter's resolver; variables keep their values between runs.
+	bool execute(const Ast *program);
+
+	// the value of a variable, NONE if it has not been assigned.
+	const Value &get(const std::string &name) const;
+
+	Value visit(const VarNode *node);
+	Value visit(const AssignNode *node);
+	Value visit(const PrintNode *node);
+	Value visit(const AddNode *node);
+	Value visit(const MultNode *node);
+	Value visit(const DotProductNode *node);
+	Value visit(const IntNode *node);
+	Value visit(const VecNode *node);
+	Value visit(const StatListNode *node);
+	Value visit_unknown(const Ast *node);
+
+private:
+	Value error(const std::string &message);
+
+	SlotResolver resolver;
+	std::vector<Value> slots;
+	OutputSink out;
+	bool failed = false;
+};
+
+#endif // !_INTERPRETER_H
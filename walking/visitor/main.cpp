@@ -1,14 +1,13 @@
 #include "ast.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "vm.h"
 
 
 
 IntNode* get_int_node(int i)
 {
-	std::stringstream ss;
-	ss << i;
-
-	auto node = new IntNode(new AstToken(AstToken::INT, ss.str()));
-	return node;
+	return new IntNode(i);
 }
 
 
@@ -37,6 +36,34 @@ int main()
 	auto vistor = new AstVisitor();
 	stats_list->visit(vistor);
 
+	// the same program, parsed from text
+	std::cout << "--------------------------------" << std::endl;
+	auto lexer = Lexer("x = 1 + 4; print x * [2, 3, 4]; a . b");
+	auto parser = Parser(lexer);
+	auto program = parser.program();
+	if (program != nullptr)
+		program->visit(vistor);
+
+	// and run
+	std::cout << "--------------------------------" << std::endl;
+	Interpreter interpreter;
+	interpreter.run(stats_list);
+	if (program != nullptr)
+		interpreter.run(program);
+
+	// and compile to bytecode, for the VM
+	std::cout << "--------------------------------" << std::endl;
+	Bytecode code;
+	BytecodeCompiler compiler;
+	VM vm;
+	if (compiler.compile(stats_list, code))
+		vm.run(code);
+	if (program != nullptr && compiler.compile(program, code))
+		vm.run(code);
+
+	delete program;
+	delete stats_list;
+	delete vistor;
 	return 0;
 
 }
\ No newline at end of file
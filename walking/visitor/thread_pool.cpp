@@ -0,0 +1,82 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t threads)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	for (size_t i = 1; i < threads; ++i)
+		workers.emplace_back(&ThreadPool::run, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	wake.notify_all();
+	for (auto &worker : workers)
+		worker.join();
+}
+
+size_t ThreadPool::size() const
+{
+	return workers.size() + 1;
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)> &task)
+{
+	if (workers.empty() || count <= 1)
+	{
+		for (size_t i = 0; i < count; ++i)
+			task(i);
+		return;
+	}
+	std::lock_guard<std::mutex> loop(loop_mutex);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->task = &task;
+		this->count = count;
+		next = 0;
+		busy = workers.size();
+		++generation;
+	}
+	wake.notify_all();
+	work(task, count);
+	// every worker checks in before the loop's task goes out of scope.
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this]() { return busy == 0; });
+	this->task = nullptr;
+}
+
+ThreadPool &ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::work(const std::function<void(size_t)> &task, size_t count)
+{
+	for (auto i = next++; i < count; i = next++)
+		task(i);
+}
+
+void ThreadPool::run()
+{
+	uint64_t seen = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [&]() { return stop || generation != seen; });
+		if (stop)
+			break;
+		seen = generation;
+		auto loop_task = task;
+		auto loop_count = count;
+		lock.unlock();
+		work(*loop_task, loop_count);
+		lock.lock();
+		if (--busy == 0)
+			done.notify_one();
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads that split a loop between them:
+//
+//   ThreadPool pool(4);
+//   pool.parallel_for(chunks, [&](size_t i) { ...chunk i... });
+//
+// The calling thread takes tasks too, so a pool of n threads starts n - 1
+// workers. One loop runs at a time; a task must not start another loop
+// on its own pool.
+class ThreadPool
+{
+public:
+	// threads == 0 means one per hardware thread.
+	explicit ThreadPool(size_t threads = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool &operator=(const ThreadPool&) = delete;
+
+	// threads that run tasks, the caller's included.
+	size_t size() const;
+	// calls task(i) for every i below count and returns when all are done.
+	// Which thread runs which i is up to the pool.
+	void parallel_for(size_t count, const std::function<void(size_t)> &task);
+
+	// a pool with a thread per hardware thread, started on first use.
+	static ThreadPool &shared();
+
+private:
+	void run();
+	void work(const std::function<void(size_t)> &task, size_t count);
+
+	std::mutex loop_mutex;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(size_t)> *task = nullptr;
+	size_t count = 0;
+	std::atomic<size_t> next{0};
+	size_t busy = 0;
+	uint64_t generation = 0;
+	bool stop = false;
+	std::vector<std::thread> workers;
+};
+
+#endif // !_THREAD_POOL_H
@@ -0,0 +1,353 @@
+#include "vec_kernels.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#if !defined(AST_NO_SIMD) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define VEC_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+const size_t VecKernels::PARALLEL_CHUNK;
+const size_t VecKernels::DEFAULT_PARALLEL_THRESHOLD;
+
+namespace
+{
+	struct Table
+	{
+		VecKernels::Level level;
+		void (*scale)(int64_t k, const int64_t *in, int64_t *out, size_t n);
+		void (*add)(const int64_t *a, const int64_t *b, int64_t *out, size_t n);
+		void (*mult)(const int64_t *a, const int64_t *b, int64_t *out, size_t n);
+		int64_t (*dot)(const int64_t *a, const int64_t *b, size_t n);
+	};
+
+	// products and sums are taken in uint64_t, where they wrap without
+	// undefined behaviour, as the vector instructions do.
+	int64_t wrap_add(int64_t a, int64_t b)
+	{
+		return (int64_t)((uint64_t)a + (uint64_t)b);
+	}
+
+	int64_t wrap_mult(int64_t a, int64_t b)
+	{
+		return (int64_t)((uint64_t)a * (uint64_t)b);
+	}
+
+	void scale_scalar(int64_t k, const int64_t *in, int64_t *out, size_t n)
+	{
+		for (size_t i = 0; i < n; ++i)
+			out[i] = wrap_mult(k, in[i]);
+	}
+
+	void add_scalar(const int64_t *a, const int64_t *b, int64_t *out, size_t n)
+	{
+		for (size_t i = 0; i < n; ++i)
+			out[i] = wrap_add(a[i], b[i]);
+	}
+
+	void mult_scalar(const int64_t *a, const int64_t *b, int64_t *out, size_t n)
+	{
+		for (size_t i = 0; i < n; ++i)
+			out[i] = wrap_mult(a[i], b[i]);
+	}
+
+	int64_t dot_scalar(const int64_t *a, const int64_t *b, size_t n)
+	{
+		int64_t sum = 0;
+		for (size_t i = 0; i < n; ++i)
+			sum = wrap_add(sum, wrap_mult(a[i], b[i]));
+		return sum;
+	}
+
+	const Table scalar_table = { VecKernels::SCALAR, scale_scalar, add_scalar, mult_scalar, dot_scalar };
+
+#ifdef VEC_KERNELS_X86
+	// neither SSE2 nor AVX2 multiplies 64-bit lanes. The low 64 bits of
+	// a * b are lo(a)*lo(b) + ((hi(a)*lo(b) + lo(a)*hi(b)) << 32), with
+	// each part a 32x32->64 bit multiply.
+	__m128i mul64_sse2(__m128i a, __m128i b)
+	{
+		auto low = _mm_mul_epu32(a, b);
+		auto cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b),
+			_mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+		return _mm_add_epi64(low, _mm_slli_epi64(cross, 32));
+	}
+
+	void scale_sse2(int64_t k, const int64_t *in, int64_t *out, size_t n)
+	{
+		auto kk = _mm_set1_epi64x(k);
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2)
+		{
+			auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), mul64_sse2(kk, v));
+		}
+		scale_scalar(k, in + i, out + i, n - i);
+	}
+
+	void add_sse2(const int64_t *a, const int64_t *b, int64_t *out, size_t n)
+	{
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2)
+		{
+			auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+			auto y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_add_epi64(x, y));
+		}
+		add_scalar(a + i, b + i, out + i, n - i);
+	}
+
+	void mult_sse2(const int64_t *a, const int64_t *b, int64_t *out, size_t n)
+	{
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2)
+		{
+			auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+			auto y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), mul64_sse2(x, y));
+		}
+		mult_scalar(a + i, b + i, out + i, n - i);
+	}
+
+	int64_t dot_sse2(const int64_t *a, const int64_t *b, size_t n)
+	{
+		auto sums = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2)
+		{
+			auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+			auto y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+			sums = _mm_add_epi64(sums, mul64_sse2(x, y));
+		}
+		int64_t lanes[2];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sums);
+		return wrap_add(wrap_add(lanes[0], lanes[1]), dot_scalar(a + i, b + i, n - i));
+	}
+
+	__attribute__((target("avx2")))
+	__m256i mul64_avx2(__m256i a, __m256i b)
+	{
+		auto low = _mm256_mul_epu32(a, b);
+		auto cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+			_mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+		return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+	}
+
+	__attribute__((target("avx2")))
+	void scale_avx2(int64_t k, const int64_t *in, int64_t *out, size_t n)
+	{
+		auto kk = _mm256_set1_epi64x(k);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), mul64_avx2(kk, v));
+		}
+		scale_scalar(k, in + i, out + i, n - i);
+	}
+
+	__attribute__((target("avx2")))
+	void add_avx2(const int64_t *a, const int64_t *b, int64_t *out, size_t n)
+	{
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+			auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi64(x, y));
+		}
+		add_scalar(a + i, b + i, out + i, n - i);
+	}
+
+	__attribute__((target("avx2")))
+	void mult_avx2(const int64_t *a, const int64_t *b, int64_t *out, size_t n)
+	{
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+			auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), mul64_avx2(x, y));
+		}
+		mult_scalar(a + i, b + i, out + i, n - i);
+	}
+
+	__attribute__((target("avx2")))
+	int64_t dot_avx2(const int64_t *a, const int64_t *b, size_t n)
+	{
+		auto sums = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+			auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+			sums = _mm256_add_epi64(sums, mul64_avx2(x, y));
+		}
+		int64_t lanes[4];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sums);
+		auto sum = wrap_add(wrap_add(lanes[0], lanes[1]), wrap_add(lanes[2], lanes[3]));
+		return wrap_add(sum, dot_scalar(a + i, b + i, n - i));
+	}
+
+	const Table sse2_table = { VecKernels::SSE2, scale_sse2, add_sse2, mult_sse2, dot_sse2 };
+	const Table avx2_table = { VecKernels::AVX2, scale_avx2, add_avx2, mult_avx2, dot_avx2 };
+#endif
+
+	const Table *table_for(VecKernels::Level level)
+	{
+		switch (level)
+		{
+		case VecKernels::SCALAR:
+			return &scalar_table;
+#ifdef VEC_KERNELS_X86
+		case VecKernels::SSE2:
+			// part of x86-64 itself.
+			return &sse2_table;
+		case VecKernels::AVX2:
+			return __builtin_cpu_supports("avx2") ? &avx2_table : nullptr;
+#endif
+		default:
+			return nullptr;
+		}
+	}
+
+	std::atomic<const Table*> active(nullptr);
+	std::atomic<size_t> threshold(VecKernels::DEFAULT_PARALLEL_THRESHOLD);
+	std::atomic<ThreadPool*> chosen_pool(nullptr);
+
+	const Table &table()
+	{
+		auto t = active.load(std::memory_order_relaxed);
+		if (t == nullptr)
+		{
+			t = table_for(VecKernels::best_level());
+			active.store(t, std::memory_order_relaxed);
+		}
+		return *t;
+	}
+
+	// the pool to split n elements over, nullptr to stay on this thread.
+	ThreadPool *pool_for(size_t n)
+	{
+		if (n < threshold.load(std::memory_order_relaxed) || n <= VecKernels::PARALLEL_CHUNK)
+			return nullptr;
+		auto pool = chosen_pool.load(std::memory_order_relaxed);
+		if (pool == nullptr)
+			pool = &ThreadPool::shared();
+		return pool->size() > 1 ? pool : nullptr;
+	}
+
+	size_t chunks(size_t n)
+	{
+		return (n + VecKernels::PARALLEL_CHUNK - 1) / VecKernels::PARALLEL_CHUNK;
+	}
+
+	// calls f(first, length) for every chunk of n elements.
+	template<class F>
+	void for_chunks(ThreadPool &pool, size_t n, F f)
+	{
+		pool.parallel_for(chunks(n), [&](size_t c) {
+			auto first = c * VecKernels::PARALLEL_CHUNK;
+			f(first, std::min(VecKernels::PARALLEL_CHUNK, n - first));
+		});
+	}
+}
+
+void VecKernels::scale(int64_t k, const int64_t *in, int64_t *out, size_t n)
+{
+	auto &t = table();
+	auto pool = pool_for(n);
+	if (pool == nullptr)
+		t.scale(k, in, out, n);
+	else
+		for_chunks(*pool, n, [&](size_t first, size_t length) { t.scale(k, in + first, out + first, length); });
+}
+
+void VecKernels::add(const int64_t *a, const int64_t *b, int64_t *out, size_t n)
+{
+	auto &t = table();
+	auto pool = pool_for(n);
+	if (pool == nullptr)
+		t.add(a, b, out, n);
+	else
+		for_chunks(*pool, n, [&](size_t first, size_t length) { t.add(a + first, b + first, out + first, length); });
+}
+
+void VecKernels::mult(const int64_t *a, const int64_t *b, int64_t *out, size_t n)
+{
+	auto &t = table();
+	auto pool = pool_for(n);
+	if (pool == nullptr)
+		t.mult(a, b, out, n);
+	else
+		for_chunks(*pool, n, [&](size_t first, size_t length) { t.mult(a + first, b + first, out + first, length); });
+}
+
+int64_t VecKernels::dot(const int64_t *a, const int64_t *b, size_t n)
+{
+	auto &t = table();
+	auto pool = pool_for(n);
+	if (pool == nullptr)
+		return t.dot(a, b, n);
+	std::vector<int64_t> sums(chunks(n));
+	for_chunks(*pool, n, [&](size_t first, size_t length) {
+		sums[first / PARALLEL_CHUNK] = t.dot(a + first, b + first, length);
+	});
+	int64_t sum = 0;
+	for (auto s : sums)
+		sum = wrap_add(sum, s);
+	return sum;
+}
+
+VecKernels::Level VecKernels::level()
+{
+	return table().level;
+}
+
+VecKernels::Level VecKernels::best_level()
+{
+	if (table_for(AVX2) != nullptr)
+		return AVX2;
+	if (table_for(SSE2) != nullptr)
+		return SSE2;
+	return SCALAR;
+}
+
+bool VecKernels::use(Level level)
+{
+	auto t = table_for(level);
+	if (t == nullptr)
+		return false;
+	active.store(t, std::memory_order_relaxed);
+	return true;
+}
+
+const char *VecKernels::name(Level level)
+{
+	switch (level)
+	{
+	case SSE2:
+		return "sse2";
+	case AVX2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
+
+size_t VecKernels::parallel_threshold()
+{
+	return threshold.load(std::memory_order_relaxed);
+}
+
+void VecKernels::set_parallel_threshold(size_t n)
+{
+	threshold.store(n, std::memory_order_relaxed);
+}
+
+void VecKernels::set_pool(ThreadPool *pool)
+{
+	chosen_pool.store(pool, std::memory_order_relaxed);
+}
@@ -0,0 +1,56 @@
+#ifndef _VEC_KERNELS_H
+#define _VEC_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+// The vector arithmetic of the interpreter, over contiguous int64 arrays.
+// Each operation has a scalar loop and, on x86-64, SSE2 and AVX2 loops;
+// the best level the CPU supports is picked the first time one is called.
+// Arithmetic wraps around as in the scalar loop, so every level gives
+// bit-identical results, dot products included. Build with AST_NO_SIMD
+// to have the scalar loops only.
+//
+// Operations on at least parallel_threshold() elements are cut into chunks
+// of PARALLEL_CHUNK elements, which a ThreadPool works through. The chunks
+// depend on the length alone and a dot product adds up the chunks' sums
+// in chunk order, so the result does not depend on the number of threads.
+//
+// out may be the same array as an input; arrays need no alignment.
+class VecKernels
+{
+public:
+	enum Level { SCALAR, SSE2, AVX2 };
+
+	// out[i] = k * in[i]
+	static void scale(int64_t k, const int64_t *in, int64_t *out, size_t n);
+	// out[i] = a[i] + b[i]
+	static void add(const int64_t *a, const int64_t *b, int64_t *out, size_t n);
+	// out[i] = a[i] * b[i]
+	static void mult(const int64_t *a, const int64_t *b, int64_t *out, size_t n);
+	// the sum of a[i] * b[i]
+	static int64_t dot(const int64_t *a, const int64_t *b, size_t n);
+
+	// the level in use.
+	static Level level();
+	// the best level this CPU runs.
+	static Level best_level();
+	// switches to another level, e.g. to compare them; false if the CPU or
+	// the build lacks it.
+	static bool use(Level level);
+	static const char *name(Level level);
+
+	static size_t parallel_threshold();
+	// SIZE_MAX keeps every operation on the calling thread. The bench's
+	// vec_parallel records show where the pool starts to pay off.
+	static void set_parallel_threshold(size_t n);
+	// the pool for long operations, ThreadPool::shared() until set.
+	static void set_pool(ThreadPool *pool);
+
+	static const size_t PARALLEL_CHUNK = 64 * 1024;
+	static const size_t DEFAULT_PARALLEL_THRESHOLD = 256 * 1024;
+};
+
+#endif // !_VEC_KERNELS_H
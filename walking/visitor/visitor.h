@@ -0,0 +1,149 @@
+#ifndef _VISITOR_H
+#define _VISITOR_H
+
+#include "ast.h"
+#include <deque>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// for visitors that thread nothing through the walk.
+struct NoContext {};
+
+// Computes a result for every node in one bottom-up walk. A node's
+// children are walked first, left to right, and their results are handed
+// to the node's leave() hook, which Derived provides for each node class:
+//
+//   R leave(const IntNode *node, Ctx &ctx);                  (VarNode too)
+//   R leave(const AddNode *node, R left, R right, Ctx &ctx); (AssignNode,
+//                                                 MultNode, DotProductNode)
+//   R leave(const PrintNode *node, R element, Ctx &ctx);
+//   R leave(const VecNode *node, const std::vector<R> &elements, Ctx &ctx);
+//                                                           (StatListNode)
+//
+// Derived may also have enter(const XNode *node, Ctx &ctx) hooks, called
+// before the children of that class of node are walked; classes without
+// one are walked straight through. Hooks are resolved at compile time,
+// so the walk makes no virtual calls and a missing leave() fails to
+// compile. Ctx is passed along by reference: an environment, a scope
+// that enter() opens and leave() closes, a table of costs.
+//
+//   class Depth : public Visitor<Depth, int>
+//   {
+//   public:
+//       int leave(const IntNode*, NoContext&) { return 1; }
+//       ...
+//       int leave(const AddNode*, int l, int r, NoContext&) { return 1 + std::max(l, r); }
+//   };
+//   auto depth = Depth().run(program);
+//
+// The element results of a list are kept in buffers owned by the visitor,
+// so running one visitor over many trees allocates only for the deepest
+// nesting of lists it has seen.
+template<class Derived, class R, class Ctx = NoContext>
+class Visitor
+{
+	static_assert(!std::is_void<R>::value, "a Visitor returns results; use StaticVisitor for void walks");
+
+public:
+	R run(const Ast *node, Ctx &ctx)
+	{
+		return Walk(*this, ctx).dispatch(node);
+	}
+
+	R run(const Ast *node)
+	{
+		Ctx ctx;
+		return run(node, ctx);
+	}
+
+	// called for a node of no known class.
+	R leave_unknown(const Ast *node, Ctx &ctx)
+	{
+		return R();
+	}
+
+private:
+	class Walk : public StaticVisitor<Walk, R>
+	{
+	public:
+		Walk(Visitor &owner, Ctx &ctx)
+			: owner(owner), self(static_cast<Derived&>(owner)), ctx(ctx)
+		{}
+
+		R visit(const IntNode *node) { return leaf(node); }
+		R visit(const VarNode *node) { return leaf(node); }
+		R visit(const AddNode *node) { return binary(node); }
+		R visit(const AssignNode *node) { return binary(node); }
+		R visit(const MultNode *node) { return binary(node); }
+		R visit(const DotProductNode *node) { return binary(node); }
+		R visit(const VecNode *node) { return list(node); }
+		R visit(const StatListNode *node) { return list(node); }
+
+		R visit(const PrintNode *node)
+		{
+			enter(self, node, 0);
+			R element = this->dispatch(node->element);
+			return self.leave(node, std::move(element), ctx);
+		}
+
+		R visit_unknown(const Ast *node)
+		{
+			return self.leave_unknown(node, ctx);
+		}
+
+	private:
+		template<class Node>
+		R leaf(const Node *node)
+		{
+			enter(self, node, 0);
+			return self.leave(node, ctx);
+		}
+
+		template<class Node>
+		R binary(const Node *node)
+		{
+			enter(self, node, 0);
+			R left = this->dispatch(node->left);
+			R right = this->dispatch(node->right);
+			return self.leave(node, std::move(left), std::move(right), ctx);
+		}
+
+		// a deque keeps the buffers of outer lists in place while inner
+		// lists add theirs.
+		template<class Node>
+		R list(const Node *node)
+		{
+			enter(self, node, 0);
+			if (owner.depth == owner.lists.size())
+				owner.lists.emplace_back();
+			auto &results = owner.lists[owner.depth++];
+			results.clear();
+			for (auto ele : node->elements)
+				results.push_back(this->dispatch(ele));
+			R result = self.leave(node, results, ctx);
+			--owner.depth;
+			return result;
+		}
+
+		// the int argument prefers the hook, when Derived has one.
+		template<class D, class Node>
+		auto enter(D &d, const Node *node, int) -> decltype(d.enter(node, std::declval<Ctx&>()), void())
+		{
+			d.enter(node, ctx);
+		}
+
+		template<class D, class Node>
+		void enter(D &, const Node *, long)
+		{}
+
+		Visitor &owner;
+		Derived &self;
+		Ctx &ctx;
+	};
+
+	std::deque<std::vector<R>> lists;
+	size_t depth = 0;
+};
+
+#endif // !_VISITOR_H
@@ -0,0 +1,208 @@
+#include "vm.h"
+#include "vec_kernels.h"
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(AST_NO_COMPUTED_GOTO)
+#define VM_COMPUTED_GOTO 1
+#endif
+
+// the work of each instruction, shared by both dispatch loops.
+namespace
+{
+	inline void load_int(int64_t *r, const int64_t *k, const Instruction &ins)
+	{
+		r[ins.dst] = k[ins.a];
+	}
+
+	inline void load_vec(int64_t *r, const int64_t *k, const Instruction &ins)
+	{
+		std::memcpy(r + ins.dst, k + ins.a, ins.n * sizeof(int64_t));
+	}
+
+	inline void move_int(int64_t *r, const Instruction &ins)
+	{
+		r[ins.dst] = r[ins.a];
+	}
+
+	inline void move_vec(int64_t *r, const Instruction &ins)
+	{
+		std::memmove(r + ins.dst, r + ins.a, ins.n * sizeof(int64_t));
+	}
+
+	inline void add_int(int64_t *r, const Instruction &ins)
+	{
+		r[ins.dst] = (int64_t)((uint64_t)r[ins.a] + (uint64_t)r[ins.b]);
+	}
+
+	inline void add_vec(int64_t *r, const Instruction &ins)
+	{
+		VecKernels::add(r + ins.a, r + ins.b, r + ins.dst, ins.n);
+	}
+
+	inline void mult_int(int64_t *r, const Instruction &ins)
+	{
+		r[ins.dst] = (int64_t)((uint64_t)r[ins.a] * (uint64_t)r[ins.b]);
+	}
+
+	inline void scale_vec(int64_t *r, const Instruction &ins)
+	{
+		VecKernels::scale(r[ins.a], r + ins.b, r + ins.dst, ins.n);
+	}
+
+	inline void mult_vec(int64_t *r, const Instruction &ins)
+	{
+		VecKernels::mult(r + ins.a, r + ins.b, r + ins.dst, ins.n);
+	}
+
+	inline void shift_int(int64_t *r, const Instruction &ins)
+	{
+		r[ins.dst] = (int64_t)((uint64_t)r[ins.a] << ins.b);
+	}
+
+	inline void shift_vec(int64_t *r, const Instruction &ins)
+	{
+		for (uint32_t i = 0; i < ins.n; ++i)
+			r[ins.dst + i] = (int64_t)((uint64_t)r[ins.a + i] << ins.b);
+	}
+
+	inline void dot(int64_t *r, const Instruction &ins)
+	{
+		r[ins.dst] = VecKernels::dot(r + ins.a, r + ins.b, ins.n);
+	}
+
+	inline void print_int(OutputSink &out, const int64_t *r, const Instruction &ins)
+	{
+		out << r[ins.a] << '\n';
+	}
+
+	inline void print_vec(OutputSink &out, const int64_t *r, const Instruction &ins)
+	{
+		out << '[';
+		for (uint32_t i = 0; i < ins.n; ++i)
+		{
+			if (i != 0)
+				out << ", ";
+			out << r[ins.a + i];
+		}
+		out << "]\n";
+	}
+}
+
+VM::VM(std::ostream &out)
+	: out(out) {}
+
+void VM::reserve(const Bytecode &code)
+{
+	if (registers.size() < code.registers)
+		registers.resize(code.registers);
+}
+
+void VM::run(const Bytecode &code)
+{
+	reserve(code);
+	execute(code.code.data(), code.constants.data());
+}
+
+void VM::run(const ThreadedCode &code)
+{
+	reserve(*code.source);
+#ifdef VM_COMPUTED_GOTO
+	execute_threaded(code.steps.data(), code.source->constants.data(), registers.data(), &out);
+#else
+	execute(code.source->code.data(), code.source->constants.data());
+#endif
+}
+
+ThreadedCode VM::prepare(const Bytecode &code)
+{
+	ThreadedCode threaded;
+	threaded.source = &code;
+	threaded.steps.reserve(code.code.size());
+#ifdef VM_COMPUTED_GOTO
+	auto handlers = execute_threaded(nullptr, nullptr, nullptr, nullptr);
+#endif
+	for (auto &ins : code.code)
+	{
+#ifdef VM_COMPUTED_GOTO
+		threaded.steps.push_back(ThreadedCode::Step{ handlers[(int)ins.op], ins });
+#else
+		threaded.steps.push_back(ThreadedCode::Step{ nullptr, ins });
+#endif
+	}
+	return threaded;
+}
+
+bool VM::threaded()
+{
+#ifdef VM_COMPUTED_GOTO
+	return true;
+#else
+	return false;
+#endif
+}
+
+void VM::execute(const Instruction *ins, const int64_t *k)
+{
+	auto r = registers.data();
+	for (; ; ++ins)
+	{
+		switch (ins->op)
+		{
+		case Op::LOAD_INT: load_int(r, k, *ins); break;
+		case Op::LOAD_VEC: load_vec(r, k, *ins); break;
+		case Op::MOVE_INT: move_int(r, *ins); break;
+		case Op::MOVE_VEC: move_vec(r, *ins); break;
+		case Op::ADD_INT: add_int(r, *ins); break;
+		case Op::ADD_VEC: add_vec(r, *ins); break;
+		case Op::MULT_INT: mult_int(r, *ins); break;
+		case Op::SCALE_VEC: scale_vec(r, *ins); break;
+		case Op::MULT_VEC: mult_vec(r, *ins); break;
+		case Op::SHIFT_INT: shift_int(r, *ins); break;
+		case Op::SHIFT_VEC: shift_vec(r, *ins); break;
+		case Op::DOT: dot(r, *ins); break;
+		case Op::PRINT_INT: print_int(out, r, *ins); break;
+		case Op::PRINT_VEC: print_vec(out, r, *ins); break;
+		case Op::HALT:
+			out.flush();
+			return;
+		}
+	}
+}
+
+// each handler ends in its own indirect jump to the next one, which the
+// branch predictor learns per handler rather than for one shared switch.
+const void *const *VM::execute_threaded(const ThreadedCode::Step *step, const int64_t *k,
+	int64_t *r, OutputSink *out)
+{
+#ifdef VM_COMPUTED_GOTO
+	// in the order of Op.
+	static const void *const handlers[] = {
+		&&LOAD_INT, &&LOAD_VEC, &&MOVE_INT, &&MOVE_VEC, &&ADD_INT, &&ADD_VEC, &&MULT_INT,
+		&&SCALE_VEC, &&MULT_VEC, &&SHIFT_INT, &&SHIFT_VEC, &&DOT, &&PRINT_INT, &&PRINT_VEC, &&HALT,
+	};
+	static_assert(sizeof(handlers) / sizeof(handlers[0]) == (int)Op::HALT + 1, "a handler for every Op");
+	if (step == nullptr)
+		return handlers;
+
+#define NEXT() goto *(++step)->handler
+	goto *step->handler;
+LOAD_INT: load_int(r, k, step->ins); NEXT();
+LOAD_VEC: load_vec(r, k, step->ins); NEXT();
+MOVE_INT: move_int(r, step->ins); NEXT();
+MOVE_VEC: move_vec(r, step->ins); NEXT();
+ADD_INT: add_int(r, step->ins); NEXT();
+ADD_VEC: add_vec(r, step->ins); NEXT();
+MULT_INT: mult_int(r, step->ins); NEXT();
+SCALE_VEC: scale_vec(r, step->ins); NEXT();
+MULT_VEC: mult_vec(r, step->ins); NEXT();
+SHIFT_INT: shift_int(r, step->ins); NEXT();
+SHIFT_VEC: shift_vec(r, step->ins); NEXT();
+DOT: dot(r, step->ins); NEXT();
+PRINT_INT: print_int(*out, r, step->ins); NEXT();
+PRINT_VEC: print_vec(*out, r, step->ins); NEXT();
+HALT:
+	out->flush();
+#undef NEXT
+#endif
+	return nullptr;
+}
@@ -0,0 +1,63 @@
+#ifndef _VM_H
+#define _VM_H
+
+#include "bytecode.h"
+#include "output_sink.h"
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Bytecode made ready for threaded dispatch: every instruction carries
+// the address of the code that runs it, so the VM jumps from one handler
+// straight to the next instead of back through a switch. Built by
+// VM::prepare() and tied to the Bytecode it was made from.
+struct ThreadedCode
+{
+	struct Step
+	{
+		const void *handler;
+		Instruction ins;
+	};
+
+	std::vector<Step> steps;
+	const Bytecode *source = nullptr;
+};
+
+// Runs Bytecode:
+//
+//   Bytecode code;
+//   if (BytecodeCompiler().compile(program, code))
+//       VM().run(code);
+//
+// The register file is one array of int64, sized for the program and
+// kept between runs. Ints wrap around as in the Interpreter, and vector
+// arithmetic goes through VecKernels, so both print the same.
+//
+// run(Bytecode) dispatches with a switch. A program run many times can
+// be prepared once and run as ThreadedCode, which dispatches with GCC's
+// computed goto; where that is missing, or with AST_NO_COMPUTED_GOTO,
+// ThreadedCode runs through the switch as well.
+class VM
+{
+public:
+	VM(std::ostream &out = std::cout);
+
+	void run(const Bytecode &code);
+	void run(const ThreadedCode &code);
+
+	static ThreadedCode prepare(const Bytecode &code);
+	// true if ThreadedCode is dispatched by computed goto in this build.
+	static bool threaded();
+
+private:
+	void execute(const Instruction *ins, const int64_t *k);
+	// called with step == nullptr, returns the table of handler addresses.
+	static const void *const *execute_threaded(const ThreadedCode::Step *step, const int64_t *k,
+		int64_t *r, OutputSink *out);
+	void reserve(const Bytecode &code);
+
+	std::vector<int64_t> registers;
+	OutputSink out;
+};
+
+#endif // !_VM_H